@@ -0,0 +1,158 @@
+/* $Id$ */
+/** @file
+ *
+ * The kmkbuiltin commands (kmk_cp, kmk_mkdir, kmk_rm and friends) as shell
+ * builtins, saving a fork+exec for each of them in compound recipe lines.
+ *
+ * Copyright (c) 2010 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <stdio.h>
+#include "shinstance.h"
+#include "builtins.h"
+#include "output.h"
+#include "error.h"
+#include "var.h"
+#include "../../kmk/kmkbuiltin.h"
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The builtins implemented here, see is_kmk_builtin. */
+static int (* const g_apfnKmkBuiltins[])(shinstance *, int, char **) =
+{
+	kmk_catcmd, kmk_chmodcmd, kmk_cmpcmd, kmk_cpcmd, kmk_echocmd, kmk_exprcmd,
+	kmk_installcmd, kmk_lncmd, kmk_md5sumcmd, kmk_mkdircmd, kmk_mvcmd,
+	kmk_rmcmd, kmk_rmdircmd, kmk_sleepcmd
+};
+
+
+/**
+ * Runs a kmkbuiltin command.
+ *
+ * The commands do their I/O thru stdio and the process file descriptors,
+ * which is fine as long as the shell file descriptors are the process ones,
+ * i.e. in SH_FORKED_MODE without a shfile table of its own.  Redirections are
+ * then already in place and all we have to do is to keep our own buffered
+ * output and theirs in order.  Interrupts are held off so we don't longjmp
+ * out of the middle of a command.
+ */
+static int kmkbuiltin(shinstance *psh, int (*pfnCmd)(int, char **, char **), int argc, char **argv)
+{
+	int rc;
+
+	output_flushall(psh);
+	INTOFF;
+	rc = pfnCmd(argc, argv, environment(psh));
+	fflush(stdout);
+	fflush(stderr);
+	clearerr(stdin);
+	INTON;
+	return rc;
+}
+
+/**
+ * Checks if the builtin is one of the kmkbuiltin commands.  These cannot
+ * write into memory for command substitution, so evalcommand forks for them.
+ */
+int is_kmk_builtin(int (*pfnBuiltin)(shinstance *, int, char **))
+{
+	unsigned i;
+	for (i = 0; i < sizeof(g_apfnKmkBuiltins) / sizeof(g_apfnKmkBuiltins[0]); i++)
+		if (g_apfnKmkBuiltins[i] == pfnBuiltin)
+			return 1;
+	return 0;
+}
+
+int kmk_catcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_cat, argc, argv);
+}
+
+int kmk_chmodcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_chmod, argc, argv);
+}
+
+int kmk_cmpcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_cmp, argc, argv);
+}
+
+int kmk_cpcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_cp, argc, argv);
+}
+
+int kmk_echocmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_echo, argc, argv);
+}
+
+int kmk_exprcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_expr, argc, argv);
+}
+
+int kmk_installcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_install, argc, argv);
+}
+
+int kmk_lncmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_ln, argc, argv);
+}
+
+int kmk_md5sumcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_md5sum, argc, argv);
+}
+
+int kmk_mkdircmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_mkdir, argc, argv);
+}
+
+int kmk_mvcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_mv, argc, argv);
+}
+
+int kmk_rmcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_rm, argc, argv);
+}
+
+int kmk_rmdircmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_rmdir, argc, argv);
+}
+
+int kmk_sleepcmd(shinstance *psh, int argc, char **argv)
+{
+	return kmkbuiltin(psh, kmk_builtin_sleep, argc, argv);
+}
+
@@ -691,6 +691,7 @@ evalcommand(shinstance *psh, union node *cmd, int flags, struct backcmd *backcmd
 	char *lastarg;
 	const char *path = pathval(psh);
 	volatile int temp_path;
+	uint64_t ts;
 #if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &argv;
@@ -705,6 +706,7 @@ evalcommand(shinstance *psh, union node *cmd, int flags, struct backcmd *backcmd
 	setstackmark(psh, &smark);
 	psh->back_exitstatus = 0;
 
+	SHSTATS_BEGIN(psh, ts);
 	arglist.lastp = &arglist.list;
 	varflag = 1;
 	/* Expand arguments, ignoring the initial 'name=value' ones */
@@ -738,6 +740,7 @@ evalcommand(shinstance *psh, union node *cmd, int flags, struct backcmd *backcmd
 		expandarg(psh, argp, &varlist, EXP_VARTILDE);
 	}
 	*varlist.lastp = NULL;
+	SHSTATS_END(psh, ts, SHSTATS_EXPAND);
 
 	argc = 0;
 	for (sp = arglist.list ; sp ; sp = sp->next)
@@ -792,7 +795,9 @@ evalcommand(shinstance *psh, union node *cmd, int flags, struct backcmd *backcmd
 
 		do {
 			int argsused, use_syspath;
+			SHSTATS_BEGIN(psh, ts);
 			find_command(psh, argv[0], &cmdentry, cmd_flags, path);
+			SHSTATS_END(psh, ts, SHSTATS_LOOKUP);
 			if (cmdentry.cmdtype == CMDUNKNOWN) {
 				psh->exitstatus = 127;
 				flushout(&psh->errout);
@@ -827,6 +832,9 @@ evalcommand(shinstance *psh, union node *cmd, int flags, struct backcmd *backcmd
 	 || ((flags & EV_BACKCMD) != 0
 	    && ((cmdentry.cmdtype != CMDBUILTIN && cmdentry.cmdtype != CMDSPLBLTIN)
 		 || cmdentry.u.bltin == dotcmd
+#ifdef SH_WITH_KMK_BUILTINS
+		 || is_kmk_builtin(cmdentry.u.bltin)
+#endif
 		 || cmdentry.u.bltin == evalcmd))) {
 		INTOFF;
 		jp = makejob(psh, cmd, 1);
@@ -1015,7 +1023,9 @@ normal_fork:
 #endif
 #endif
 
+			SHSTATS_BEGIN(psh, ts);
 			psh->exitstatus = cmdentry.u.bltin(psh, argc, argv);
+			SHSTATS_END(psh, ts, SHSTATS_BUILTIN);
 		} else {
 			e = psh->exception;
 			psh->exitstatus = e == EXINT ? SIGINT + 128 :
@@ -541,6 +541,16 @@ find_command(shinstance *psh, char *name, struct cmdentry *entry, int act, const
 
 	/* If name contains a slash, don't use PATH or hash table */
 	if (strchr(name, '/') != NULL) {
+#ifdef SH_WITH_KMK_BUILTINS
+		/* $(RM_EXT) and friends: kmk_rm is the builtin wherever it lives. */
+		const char *base = strrchr(name, '/') + 1;
+		if (strncmp(base, "kmk_", 4) == 0
+		 && (bltin = find_builtin(psh, (char *)base)) != 0) {
+			entry->cmdtype = CMDBUILTIN;
+			entry->u.bltin = bltin;
+			return;
+		}
+#endif
 		if (act & DO_ABS) {
 			while (shfile_stat(&psh->fdtab, name, &statb) < 0) {
 #ifdef SYSV
@@ -85,5 +85,8 @@ void defun(struct shinstance *, char *, union node *);
 int unsetfunc(struct shinstance *, char *);
 int typecmd(struct shinstance *, int, char **);
 void hash_special_builtins(struct shinstance *);
+#ifdef SH_WITH_KMK_BUILTINS
+int is_kmk_builtin(int (*)(struct shinstance *, int, char **));
+#endif
 
 #endif
@@ -105,19 +105,16 @@ STATIC struct strlist *expsort(struct strlist *);
 STATIC struct strlist *msort(struct strlist *, int);
 STATIC int pmatch(char *, char *, int);
 STATIC char *cvtnum(shinstance *, int, char *);
+STATIC void stputmem(shinstance *, const char *, size_t);
+STATIC void strtodest(shinstance *, const char *, const char *, int);
 
 /*
- * Expand shell variables and backquotes inside a here document.
+ * The characters argstr must look at; everything else is copied verbatim.
  */
-
-void
-expandhere(shinstance *psh, union node *arg, int fd)
-{
-	psh->herefd = fd;
-	expandarg(psh, arg, (struct arglist *)NULL, 0);
-	xwrite(psh, fd, stackblock(psh), psh->expdest - stackblock(psh));
-}
-
+static const char argstr_special[] = {
+	CTLESC, CTLVAR, CTLENDVAR, CTLBACKQ, CTLBACKQ | CTLQUOTE, CTLARI,
+	CTLENDARI, CTLQUOTEMARK, CTLQUOTEEND, ':', '=', '\0'
+};
 
 /*
  * Perform variable substitution and command substitution on an argument,
@@ -179,6 +176,7 @@ STATIC void
 argstr(shinstance *psh, char *p, int flag)
 {
 	char c;
+	size_t len;
 	int quotes = flag & (EXP_FULL | EXP_CASE);	/* do CTLESC */
 	int firsteq = 1;
 	const char *ifs = NULL;
@@ -241,10 +239,19 @@ argstr(shinstance *psh, char *p, int flag)
 			break;
 		default:
 			STPUTC(psh, c, psh->expdest);
-			if (flag & EXP_IFS_SPLIT & ifs_split && strchr(ifs, c) != NULL) {
-				/* We need to get the output split here... */
-				recordregion(psh, (int)(psh->expdest - stackblock(psh) - 1),
-						(int)(psh->expdest - stackblock(psh)), 0);
+			if (flag & EXP_IFS_SPLIT & ifs_split) {
+				if (strchr(ifs, c) != NULL) {
+					/* We need to get the output split here... */
+					recordregion(psh, (int)(psh->expdest - stackblock(psh) - 1),
+							(int)(psh->expdest - stackblock(psh)), 0);
+				}
+				break;
+			}
+			/* No splitting, so copy the plain run that follows in one go. */
+			len = strcspn(p, argstr_special);
+			if (len != 0) {
+				stputmem(psh, p, len);
+				p += len;
 			}
 			break;
 		}
@@ -416,7 +423,6 @@ expbackq(shinstance *psh, union node *cmd, int quoted, int flag)
 	char lastc;
 	int startloc = (int)(dest - stackblock(psh));
 	char const *syntax = quoted? DQSYNTAX : BASESYNTAX;
-	int saveherefd;
 	int quotes = flag & (EXP_FULL | EXP_CASE);
 #ifdef SH_DEAL_WITH_CRLF
 	int pending_cr = 0;
@@ -426,15 +432,12 @@ expbackq(shinstance *psh, union node *cmd, int quoted, int flag)
 	saveifs = psh->ifsfirst;
 	savelastp = psh->ifslastp;
 	saveargbackq = psh->argbackq;
-	saveherefd = psh->herefd;
-	psh->herefd = -1;
 	p = grabstackstr(psh, dest);
 	evalbackcmd(psh, cmd, &in);
 	ungrabstackstr(psh, p, dest);
 	psh->ifsfirst = saveifs;
 	psh->ifslastp = savelastp;
 	psh->argbackq = saveargbackq;
-	psh->herefd = saveherefd;
 
 	p = in.buf;
 	lastc = '\0';
@@ -507,14 +510,11 @@ subevalvar(shinstance *psh, char *p, char *str, int strloc, int subtype, int sta
 	char *loc = NULL;
 	char *q;
 	int c = 0;
-	int saveherefd = psh->herefd;
 	struct nodelist *saveargbackq = psh->argbackq;
 	int amount;
 
-	psh->herefd = -1;
 	argstr(psh, p, 0);
 	STACKSTRNUL(psh, psh->expdest);
-	psh->herefd = saveherefd;
 	psh->argbackq = saveargbackq;
 	startp = stackblock(psh) + startloc;
 	if (str == NULL)
@@ -685,17 +685,10 @@ again: /* jump here after setting a variable with ${var=text} */
 			char const *syntax = (varflags & VSQUOTE) ? DQSYNTAX
 								  : BASESYNTAX;
 
-			if (subtype == VSLENGTH) {
-				for (;*val; val++)
-					varlen++;
-			} else {
-				while (*val) {
-					if (quotes && syntax[(int)*val] == CCTL)
-						STPUTC(psh, CTLESC, psh->expdest);
-					STPUTC(psh, *val++, psh->expdest);
-				}
-
-			}
+			if (subtype == VSLENGTH)
+				varlen = (int)strlen(val);
+			else
+				strtodest(psh, val, syntax, quotes);
 		}
 	}
 
@@ -848,21 +841,10 @@ varvalue(shinstance *psh, char *name, int quoted, int subtype, int flag)
 	int i;
 	char sep;
 	char **ap;
-	char const *syntax;
 
 #define STRTODEST(p) \
-	do {\
-	if (flag & (EXP_FULL | EXP_CASE) && subtype != VSLENGTH) { \
-		syntax = quoted? DQSYNTAX : BASESYNTAX; \
-		while (*p) { \
-			if (syntax[(int)*p] == CCTL) \
-				STPUTC(psh, CTLESC, psh->expdest); \
-			STPUTC(psh, *p++, psh->expdest); \
-		} \
-	} else \
-		while (*p) \
-			STPUTC(psh, *p++, psh->expdest); \
-	} while (0)
+	strtodest(psh, p, quoted ? DQSYNTAX : BASESYNTAX, \
+		  flag & (EXP_FULL | EXP_CASE) && subtype != VSLENGTH)
 
 
 	switch (*name) {
@@ -925,6 +907,49 @@ numvar:
 
 
 
+/*
+ * Append len bytes to the string being built at psh->expdest.
+ * makestrspace only grows the block once, hence the loop.
+ */
+
+STATIC void
+stputmem(shinstance *psh, const char *p, size_t len)
+{
+	while (psh->sstrnleft < (int)len)
+		psh->expdest = makestrspace(psh);
+	memcpy(psh->expdest, p, len);
+	STADJUST(psh, (int)len, psh->expdest);
+}
+
+
+/*
+ * Copy a value to psh->expdest, escaping characters that are special in
+ * syntax when quotes is set.  The runs in between are copied in bulk.
+ */
+
+STATIC void
+strtodest(shinstance *psh, const char *p, const char *syntax, int quotes)
+{
+	const char *start;
+
+	for (;;) {
+		start = p;
+		if (quotes) {
+			while (*p && syntax[(int)*p] != CCTL)
+				p++;
+		} else
+			p += strlen(p);
+		if (p != start)
+			stputmem(psh, start, p - start);
+		if (*p == '\0')
+			break;
+		STPUTC(psh, CTLESC, psh->expdest);
+		STPUTC(psh, *p++, psh->expdest);
+	}
+}
+
+
+
 /*
  * Record the fact that we have to scan this region of the
  * string for IFS characters.
@@ -961,6 +986,10 @@ recordregion(shinstance *psh, int start, int end, int inquotes)
  * strings to the argument list.  The regions of the string to be
  * searched for IFS characters have been stored by recordregion.
  */
+#define IFS_NONE	0
+#define IFS_OTHER	1
+#define IFS_SPACE	2
+
 STATIC void
 ifsbreakup(shinstance *psh, char *string, struct arglist *arglist)
 {
@@ -969,12 +998,14 @@ ifsbreakup(shinstance *psh, char *string, struct arglist *arglist)
 	char *start;
 	char *p;
 	char *q;
+	char *end;
 	const char *ifs;
-	const char *ifsspc;
+	int ifsspc;
 	int inquotes;
+	char ifsmap[256];	/* IFS_NONE, IFS_OTHER or IFS_SPACE per char */
 
 	start = string;
-	ifsspc = NULL;
+	ifsspc = 0;
 	inquotes = 0;
 
 	if (psh->ifslastp == NULL) {
@@ -986,31 +1017,42 @@ ifsbreakup(shinstance *psh, char *string, struct arglist *arglist)
 		return;
 	}
 
+	/*
+	 * Classify the characters once instead of doing two strchr calls on
+	 * each of them.  A NUL counts as IFS whitespace, like strchr would.
+	 */
 	ifs = ifsset(psh) ? ifsval(psh) : " \t\n";
+	memset(ifsmap, IFS_NONE, sizeof(ifsmap));
+	for (; *ifs; ifs++)
+		ifsmap[(unsigned char)*ifs] = strchr(" \t\n", *ifs) ? IFS_SPACE : IFS_OTHER;
+	ifsmap[0] = IFS_SPACE;
 
 	for (ifsp = &psh->ifsfirst; ifsp != NULL; ifsp = ifsp->next) {
 		p = string + ifsp->begoff;
+		end = string + ifsp->endoff;
 		inquotes = ifsp->inquotes;
-		ifsspc = NULL;
-		while (p < string + ifsp->endoff) {
+		ifsspc = 0;
+		while (p < end) {
 			q = p;
 			if (*p == CTLESC)
 				p++;
 			if (inquotes) {
 				/* Only NULs (probably from "$@") end args */
 				if (*p != 0) {
-					p++;
+					p = memchr(p, '\0', end - p);
+					if (p == NULL)
+						p = end;
 					continue;
 				}
 			} else {
-				if (!strchr(ifs, *p)) {
+				if (ifsmap[(unsigned char)*p] == IFS_NONE) {
 					p++;
 					continue;
 				}
-				ifsspc = strchr(" \t\n", *p);
+				ifsspc = ifsmap[(unsigned char)*p] == IFS_SPACE;
 
 				/* Ignore IFS whitespace at start */
-				if (q == start && ifsspc != NULL) {
+				if (q == start && ifsspc) {
 					p++;
 					start = p;
 					continue;
@@ -1025,17 +1067,17 @@ ifsbreakup(shinstance *psh, char *string, struct arglist *arglist)
 			arglist->lastp = &sp->next;
 			p++;
 
-			if (ifsspc != NULL) {
+			if (ifsspc) {
 				/* Ignore further trailing IFS whitespace */
-				for (; p < string + ifsp->endoff; p++) {
+				for (; p < end; p++) {
 					q = p;
 					if (*p == CTLESC)
 						p++;
-					if (strchr(ifs, *p) == NULL) {
+					if (ifsmap[(unsigned char)*p] == IFS_NONE) {
 						p = q;
 						break;
 					}
-					if (strchr(" \t\n", *p) == NULL) {
+					if (ifsmap[(unsigned char)*p] != IFS_SPACE) {
 						p++;
 						break;
 					}
@@ -1088,22 +1130,15 @@ ifsfree(shinstance *psh)
 STATIC void
 expandmeta(shinstance *psh, struct strlist *str, int flag)
 {
-	char *p;
 	struct strlist **savelastp;
 	struct strlist *sp;
-	char c;
 	/* TODO - EXP_REDIR */
 
 	while (str) {
 		if (fflag(psh))
 			goto nometa;
-		p = str->text;
-		for (;;) {			/* fast check for meta chars */
-			if ((c = *p++) == '\0')
-				goto nometa;
-			if (c == '*' || c == '?' || c == '[' || c == '!')
-				break;
-		}
+		if (strpbrk(str->text, "*?[!") == NULL)	/* fast check for meta chars */
+			goto nometa;
 		savelastp = psh->exparg.lastp;
 		INTOFF;
 		if (psh->expdir == NULL) {
@@ -1483,16 +1518,16 @@ breakloop:
  * Remove any CTLESC characters from a string.
  */
 
+static const char rmescapes_chars[] = { CTLESC, CTLQUOTEMARK, '\0' };
+
 void
 rmescapes(shinstance *psh, char *str)
 {
 	char *p, *q;
 
-	p = str;
-	while (*p != CTLESC && *p != CTLQUOTEMARK) {
-		if (*p++ == '\0')
-			return;
-	}
+	p = strpbrk(str, rmescapes_chars);
+	if (p == NULL)
+		return;
 	q = p;
 	while (*p) {
 		if (*p == CTLQUOTEMARK) {
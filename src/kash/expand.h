@@ -62,7 +62,6 @@ struct arglist {
 
 
 union node;
-void expandhere(struct shinstance *, union node *, int);
 void expandarg(struct shinstance *, union node *, struct arglist *, int);
 void expari(struct shinstance *, int);
 int patmatch(struct shinstance *, char *, char *, int);
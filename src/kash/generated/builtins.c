@@ -40,6 +40,36 @@ const struct builtincmd builtincmd[] = {
 	{ "[",	testcmd },
 	{ "kill",	killcmd },
 	{ "wordexp",	wordexpcmd },
+#ifdef SH_WITH_KMK_BUILTINS
+	{ "kmk_cat",	kmk_catcmd },
+	{ "kmk_builtin_cat",	kmk_catcmd },
+	{ "kmk_chmod",	kmk_chmodcmd },
+	{ "kmk_builtin_chmod",	kmk_chmodcmd },
+	{ "kmk_cmp",	kmk_cmpcmd },
+	{ "kmk_builtin_cmp",	kmk_cmpcmd },
+	{ "kmk_cp",	kmk_cpcmd },
+	{ "kmk_builtin_cp",	kmk_cpcmd },
+	{ "kmk_echo",	kmk_echocmd },
+	{ "kmk_builtin_echo",	kmk_echocmd },
+	{ "kmk_expr",	kmk_exprcmd },
+	{ "kmk_builtin_expr",	kmk_exprcmd },
+	{ "kmk_install",	kmk_installcmd },
+	{ "kmk_builtin_install",	kmk_installcmd },
+	{ "kmk_ln",	kmk_lncmd },
+	{ "kmk_builtin_ln",	kmk_lncmd },
+	{ "kmk_md5sum",	kmk_md5sumcmd },
+	{ "kmk_builtin_md5sum",	kmk_md5sumcmd },
+	{ "kmk_mkdir",	kmk_mkdircmd },
+	{ "kmk_builtin_mkdir",	kmk_mkdircmd },
+	{ "kmk_mv",	kmk_mvcmd },
+	{ "kmk_builtin_mv",	kmk_mvcmd },
+	{ "kmk_rm",	kmk_rmcmd },
+	{ "kmk_builtin_rm",	kmk_rmcmd },
+	{ "kmk_rmdir",	kmk_rmdircmd },
+	{ "kmk_builtin_rmdir",	kmk_rmdircmd },
+	{ "kmk_sleep",	kmk_sleepcmd },
+	{ "kmk_builtin_sleep",	kmk_sleepcmd },
+#endif
 	{ 0, 0 },
 };
 
@@ -55,3 +55,19 @@ int ulimitcmd(shinstance *, int, char **);
 int testcmd(shinstance *, int, char **);
 int killcmd(shinstance *, int, char **);
 int wordexpcmd(shinstance *, int, char **);
+#ifdef SH_WITH_KMK_BUILTINS
+int kmk_catcmd(shinstance *, int, char **);
+int kmk_chmodcmd(shinstance *, int, char **);
+int kmk_cmpcmd(shinstance *, int, char **);
+int kmk_cpcmd(shinstance *, int, char **);
+int kmk_echocmd(shinstance *, int, char **);
+int kmk_exprcmd(shinstance *, int, char **);
+int kmk_installcmd(shinstance *, int, char **);
+int kmk_lncmd(shinstance *, int, char **);
+int kmk_md5sumcmd(shinstance *, int, char **);
+int kmk_mkdircmd(shinstance *, int, char **);
+int kmk_mvcmd(shinstance *, int, char **);
+int kmk_rmcmd(shinstance *, int, char **);
+int kmk_rmdircmd(shinstance *, int, char **);
+int kmk_sleepcmd(shinstance *, int, char **);
+#endif
@@ -166,14 +166,8 @@ init(shinstance *psh) {
 
       /* from /Volumes/ScratchHFS/bird/kBuild/svn/trunk/src/kash/var.c: */
       {
-	      char **envp;
-
 	      initvar(psh);
-	      for (envp = sh_environ(psh) ; *envp ; envp++) {
-		      if (strchr(*envp, '=')) {
-			      setvareq(psh, *envp, VEXPORT|VTEXTFIXED);
-		      }
-	      }
+	      importenv(psh);
       }
 }
 
@@ -781,8 +781,10 @@ int
 forkshell(shinstance *psh, struct job *jp, union node *n, int mode)
 {
 	int pid;
+	uint64_t ts;
 
 	TRACE((psh, "forkshell(%%%d, %p, %d) called\n", jp - psh->jobtab, n, mode));
+	SHSTATS_BEGIN(psh, ts);
 	switch ((pid = sh_fork(psh))) {
 	case -1:
 		TRACE((psh, "Fork failed, errno=%d\n", errno));
@@ -793,6 +795,7 @@ forkshell(shinstance *psh, struct job *jp, union node *n, int mode)
 		forkchild(psh, jp, n, mode, 0);
 		return 0;
 	default:
+		SHSTATS_END(psh, ts, SHSTATS_FORK);
 		return forkparent(psh, jp, n, mode, pid);
 	}
 }
@@ -916,12 +919,15 @@ waitforjob(shinstance *psh, struct job *jp)
 #endif
 	int status;
 	int st;
+	uint64_t ts;
 
 	INTOFF;
 	TRACE((psh, "waitforjob(%%%d) called\n", jp - psh->jobtab + 1));
+	SHSTATS_BEGIN(psh, ts);
 	while (jp->state == JOBRUNNING) {
 		dowait(psh, 1, jp);
 	}
+	SHSTATS_END(psh, ts, SHSTATS_WAIT);
 #if JOBS
 	if (jp->jobctl) {
 		if (sh_tcsetpgrp(psh, psh->ttyfd, mypgrp) == -1)
@@ -242,6 +242,10 @@ state3:
 		for (i = 0; i < SIGSSIZE; i++)
 		    setsignal(psh, sigs[i], 0);
 	}
+	if (statsflag(psh) && psh->stats_calls[SHSTATS_STARTUP] == 0) {
+		psh->stats_ns[SHSTATS_STARTUP] = sh_nanots() - psh->stats_start;
+		psh->stats_calls[SHSTATS_STARTUP] = 1;
+	}
 
 	if (psh->minusc)
 		evalstring(psh, psh->minusc, 0);
@@ -433,6 +437,28 @@ exitcmd(struct shinstance *psh, int argc, char **argv)
 }
 
 
+/*
+ * Report the time spent in each phase when the stats option is set.
+ * Nested phases, like a command substitution inside an expansion, are
+ * counted in both.
+ */
+
+void
+printstats(shinstance *psh)
+{
+	static const char * const names[SHSTATS_MAX] = {
+		"startup", "parse", "expand", "lookup", "builtin", "fork", "wait"
+	};
+	int i;
+
+	for (i = 0; i < SHSTATS_MAX; i++)
+		outfmt(psh->out2, "kash stats: %-8s %10lu us %8u calls\n", names[i],
+		    (unsigned long)(psh->stats_ns[i] / 1000), psh->stats_calls[i]);
+	outfmt(psh->out2, "kash stats: %-8s %10lu us\n", "total",
+	    (unsigned long)((sh_nanots() - psh->stats_start) / 1000));
+}
+
+
 STATIC const char *
 strip_argv0(const char *argv0, unsigned *lenp)
 {
@@ -464,7 +490,10 @@ usage(const char *argv0)
 		    "   or: %.*s -s [-aCefnuvxIimqVEb] [+aCefnuvxIimqVEb] [-o option_name]\n"
 		    "               [+o option_name] [argument ...]\n"
 		    "   or: %.*s --help\n"
-		    "   or: %.*s --version\n",
+		    "   or: %.*s --version\n"
+		    "\n"
+		    "--option_name is the same as -o option_name.  Use --stats to get\n"
+		    "the time spent in each phase of the shell reported at exit.\n",
 		    len, argv0, len, argv0, len, argv0, len, argv0, len, argv0);
 	return 0;
 }
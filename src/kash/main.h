@@ -40,5 +40,6 @@
 
 void readcmdfile(struct shinstance *, char *);
 void cmdloop(struct shinstance *, int);
+void printstats(struct shinstance *);
 int dotcmd(struct shinstance *, int, char **);
 int exitcmd(struct shinstance *, int, char **);
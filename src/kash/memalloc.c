@@ -118,7 +118,6 @@ savestr(struct shinstance *psh, const char *s)
 //char *stacknxt = stackbase.space;
 //int stacknleft = MINSIZE;
 //int sstrnleft;
-//int herefd = -1;
 
 pointer
 stalloc(shinstance *psh, size_t nbytes)
@@ -274,11 +273,6 @@ char *
 growstackstr(shinstance *psh)
 {
 	int len = stackblocksize(psh);
-	if (psh->herefd >= 0 && len >= 1024) {
-		xwrite(psh, psh->herefd, stackblock(psh), len);
-		psh->sstrnleft = len - 1;
-		return stackblock(psh);
-	}
 	growstackblock(psh);
 	psh->sstrnleft = stackblocksize(psh) - len - 1;
 	return stackblock(psh) + len;
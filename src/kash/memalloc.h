@@ -44,8 +44,7 @@ struct stackmark {
 
 /*extern char *stacknxt;
 extern int stacknleft;
-extern int sstrnleft;
-extern int herefd;*/
+extern int sstrnleft;*/
 
 pointer ckmalloc(struct shinstance *, size_t);
 pointer ckrealloc(struct shinstance *, pointer, size_t);
@@ -171,6 +171,11 @@ options(shinstance *psh, int cmdline)
                                 }
 				break;	  /* "-" or  "--" terminates options */
 			}
+			if (cmdline && p[0] == '-') {
+				/* "--name" is the same as "-o name" */
+				minus_o(psh, p + 1, val);
+				continue;
+			}
 		} else if (c == '+') {
 			val = 0;
 		} else {
@@ -218,11 +223,11 @@ minus_o(shinstance *psh, char *name, int val)
 
 	if (name == NULL) {
 		out1str(psh, "Current option settings\n");
-		for (i = 0; i < NOPTS; i++)
+		for (i = 0; i < NOPTS && psh->optlist[i].name; i++)
 			out1fmt(psh, "%-16s%s\n", psh->optlist[i].name,
 				psh->optlist[i].val ? "on" : "off");
 	} else {
-		for (i = 0; i < NOPTS; i++)
+		for (i = 0; i < NOPTS && psh->optlist[i].name; i++)
 			if (equal(name, psh->optlist[i].name)) {
 				set_opt_val(psh, i, val);
 				return;
@@ -57,9 +57,9 @@ struct optent {
 /* Those marked [U] are required by posix, but have no effect! */
 
 #ifdef DEBUG
-# define NOPTS 21
+# define NOPTS 22
 #else
-# define NOPTS 20
+# define NOPTS 21
 #endif
 
 #ifdef DEFINE_OPTIONS
@@ -108,9 +108,11 @@ DEF_OPT( "cdprint",	0 )	/* always print result of cd */
 #define	cdprint(psh) (psh)->optlist[17].val
 DEF_OPT( "tabcomplete",	0 )	/* <tab> causes filename expansion */
 #define	tabcomplete(psh) (psh)->optlist[18].val
+DEF_OPT( "stats",	0 )	/* time the shell phases and report at exit */
+#define	statsflag(psh) (psh)->optlist[19].val
 #ifdef DEBUG
 DEF_OPT( "debug",	0 )	/* enable debug prints */
-#define	debug(psh) (psh)->optlist[19].val
+#define	debug(psh) (psh)->optlist[20].val
 #endif
 
 #ifdef DEFINE_OPTIONS
@@ -128,8 +128,11 @@ STATIC void setprompt(shinstance *, int);
 union node *
 parsecmd(shinstance *psh, int interact)
 {
+	union node *n;
+	uint64_t ts;
 	int t;
 
+	SHSTATS_BEGIN(psh, ts);
 	psh->tokpushback = 0;
 	psh->doprompt = interact;
 	if (psh->doprompt)
@@ -139,11 +142,15 @@ parsecmd(shinstance *psh, int interact)
 	psh->needprompt = 0;
 	t = readtoken(psh);
 	if (t == TEOF)
-		return NEOF;
-	if (t == TNL)
-		return NULL;
-	psh->tokpushback++;
-	return list(psh, 1);
+		n = NEOF;
+	else if (t == TNL)
+		n = NULL;
+	else {
+		psh->tokpushback++;
+		n = list(psh, 1);
+	}
+	SHSTATS_END(psh, ts, SHSTATS_PARSE);
+	return n;
 }
 
 
@@ -69,6 +69,9 @@ __RCSID("$NetBSD: redir.c,v 1.29 2004/07/08 03:57:33 christos Exp $");
 #else
 # define PIPESIZE PIPE_BUF
 #endif
+#if !defined(F_SETPIPE_SZ) && defined(__linux__)
+# define F_SETPIPE_SZ 1031	/* F_LINUX_SPECIFIC_BASE + 7, needs _GNU_SOURCE */
+#endif
 
 
 MKINIT
@@ -244,25 +247,37 @@ eopen:
 
 
 /*
- * Handle here documents.  Normally we fork off a process to write the
- * data to a pipe.  If the document is short, we can stuff the data in
- * the pipe without forking.
+ * Handle here documents.  The document is expanded here and stuffed into
+ * a pipe without forking, growing the pipe for larger documents where the
+ * system allows it.  Only when the data still doesn't fit do we fork off
+ * a process to write it.
  */
 
 STATIC int
 openhere(shinstance *psh, union node *redir)
 {
 	int pip[2];
-	size_t len = 0;
+	char *p;
+	size_t len;
 
+	if (redir->type == NHERE) {
+		p = redir->nhere.doc->narg.text;
+		len = strlen(p);
+	} else {
+		expandarg(psh, redir->nhere.doc, (struct arglist *)NULL, 0);
+		p = stackblock(psh);
+		len = psh->expdest - p;
+	}
 	if (shfile_pipe(&psh->fdtab, pip) < 0)
 		error(psh, "Pipe call failed");
-	if (redir->type == NHERE) {
-		len = strlen(redir->nhere.doc->narg.text);
-		if (len <= PIPESIZE) {
-			xwrite(psh, pip[1], redir->nhere.doc->narg.text, len);
-			goto out;
-		}
+	if (len <= PIPESIZE
+#ifdef F_SETPIPE_SZ
+	    || (len <= INT_MAX
+	        && shfile_fcntl(&psh->fdtab, pip[1], F_SETPIPE_SZ, (int)len) >= (int)len)
+#endif
+	    ) {
+		xwrite(psh, pip[1], p, len);
+		goto out;
 	}
 	if (forkshell(psh, (struct job *)NULL, (union node *)NULL, FORK_NOJOB) == 0) {
 		shfile_close(&psh->fdtab, pip[0]);
@@ -273,10 +288,7 @@ openhere(shinstance *psh, union node *redir)
 		sh_signal(psh, SIGTSTP, SH_SIG_IGN);
 #endif
 		sh_signal(psh, SIGPIPE, SH_SIG_DFL);
-		if (redir->type == NHERE)
-			xwrite(psh, pip[1], redir->nhere.doc->narg.text, len);
-		else
-			expandhere(psh, redir->nhere.doc, pip[1]);
+		xwrite(psh, pip[1], p, len);
 		sh__exit(psh, 0);
 	}
 out:
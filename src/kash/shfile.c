@@ -1200,7 +1200,10 @@ int shfile_movefd(shfdtab *pfdtab, int fdfrom, int fdto)
     return rc;
 
 #else
-    return dup2(fdfrom, fdto);
+    int fdnew = dup2(fdfrom, fdto);
+    if (fdnew >= 0 && fdfrom != fdto)
+        close(fdfrom);
+    return fdnew;
 #endif
 }
 
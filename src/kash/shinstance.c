@@ -36,6 +36,7 @@
 #else
 # include <unistd.h>
 # include <pwd.h>
+# include <sys/time.h>
 #endif
 #include "shinstance.h"
 
@@ -252,6 +253,7 @@ shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, cha
             &&  !shfile_init(&psh->fdtab, inherit ? &inherit->fdtab : NULL))
         {
             /* the special stuff. */
+            psh->stats_start = sh_nanots();
 #ifdef _MSC_VER
             psh->pid = _getpid();
 #else
@@ -273,7 +275,6 @@ shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, cha
 
             /* memalloc.c */
             psh->stacknleft = MINSIZE;
-            psh->herefd = -1;
             psh->stackp = &psh->stackbase;
             psh->stacknxt = psh->stackbase.space;
 
@@ -862,6 +863,28 @@ int sh_sysconf_clk_tck(void)
 #endif
 }
 
+/** Monotonic nanosecond timestamp for the --stats option. */
+uint64_t sh_nanots(void)
+{
+#if K_OS == K_OS_WINDOWS
+    static LARGE_INTEGER s_freq;
+    LARGE_INTEGER now;
+    if (!s_freq.QuadPart)
+        QueryPerformanceFrequency(&s_freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / s_freq.QuadPart) * 1000000000
+         + (uint64_t)(now.QuadPart % s_freq.QuadPart) * 1000000000 / s_freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
 /**
  * Adds a child to the shell
  *
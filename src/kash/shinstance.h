@@ -70,6 +70,21 @@ typedef struct shchild
 #endif
 } shchild;
 
+/**
+ * The phases timed by the --stats option.
+ */
+typedef enum shstatsphase
+{
+    SHSTATS_STARTUP = 0,                /**< Creating the shell up to running the first command. */
+    SHSTATS_PARSE,                      /**< Parsing commands. */
+    SHSTATS_EXPAND,                     /**< Expanding command words, assignments and redirections. */
+    SHSTATS_LOOKUP,                     /**< Looking up commands. */
+    SHSTATS_BUILTIN,                    /**< Running builtin commands. */
+    SHSTATS_FORK,                       /**< Forking, as seen by the parent. */
+    SHSTATS_WAIT,                       /**< Waiting for child processes. */
+    SHSTATS_MAX
+} shstatsphase;
+
 /* memalloc.c */
 #define MINSIZE 504		/* minimum size of a block */
 struct stack_block {
@@ -241,7 +256,6 @@ struct shinstance
     char               *stacknxt/* = stackbase.space*/;
     int                 stacknleft/* = MINSIZE*/;
     int                 sstrnleft;
-    int                 herefd/* = -1 */;
 
     /* memalloc.c */
     struct stack_block  stackbase;
@@ -338,6 +352,15 @@ struct shinstance
 # define VTABSIZE 517
 #endif
     struct var         *vartab[VTABSIZE];
+    char              **envlazy;        /**< open addressed table of environment entries not yet imported */
+    unsigned            envlazymask;    /**< size of envlazy minus one */
+    unsigned            envlazyleft;    /**< number of entries left in envlazy */
+    char              **envcache;       /**< cached environment() vector, NULL if stale */
+
+    /* main.c - the --stats option */
+    uint64_t            stats_start;    /**< sh_nanots() when the shell was created */
+    uint64_t            stats_ns[SHSTATS_MAX]; /**< nanoseconds spent in each phase */
+    unsigned            stats_calls[SHSTATS_MAX]; /**< times each phase was entered */
 
     /* builtins.h */
 
@@ -420,6 +443,17 @@ int sh_killpg(shinstance *, pid_t, int);
 #endif
 clock_t sh_times(shinstance *, shtms *);
 int sh_sysconf_clk_tck(void);
+uint64_t sh_nanots(void);
+/** Starts timing a --stats phase, @a ts is left zero when the option is off. */
+#define SHSTATS_BEGIN(psh, ts)      ((ts) = statsflag(psh) ? sh_nanots() : 0)
+/** Stops timing a --stats phase started by SHSTATS_BEGIN. */
+#define SHSTATS_END(psh, ts, phase) \
+    do { \
+        if (ts) { \
+            (psh)->stats_ns[phase] += sh_nanots() - (ts); \
+            (psh)->stats_calls[phase]++; \
+        } \
+    } while (0)
 
 /* wait / process */
 int sh_add_child(shinstance *psh, pid_t pid, void *hChild);
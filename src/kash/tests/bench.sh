@@ -0,0 +1,123 @@
+#!/bin/sh -
+#
+# Time a few things kmk_ash spends its life doing, optionally comparing
+# two shell binaries.
+#
+#   sh bench.sh KASH [OTHER-KASH [SCALE]]
+#
+# SCALE multiplies the iteration counts (default 1).  Set KASH_BENCH_STATS
+# to also show the --stats report of KASH for each case.  The times are the
+# user + system time of the processes each case runs, as reported by times.
+#
+
+KASH=${1:?usage: bench.sh KASH [OTHER-KASH [SCALE]]}
+OTHER=$2
+SCALE=${3:-1}
+TMP=${TMPDIR:-/tmp}/kash-bench.$$
+LC_ALL=C
+export LC_ALL
+
+trap 'rm -Rf $TMP.*' 0 1 2 15
+
+# Shell startup with an environment the size kmk usually exports.
+startup ()
+{
+  i=0
+  while test $i -lt $1; do
+    env $BIG_ENV "$2" -c : || exit 1
+    i=$((i + 1))
+  done
+}
+BIG_ENV=
+i=0
+while test $i -lt 300; do
+  BIG_ENV="$BIG_ENV KBENCH_VAR_$i=/some/path/to/tools/$i/bin:/usr/local/bin"
+  i=$((i + 1))
+done
+
+# Typical recipe lines, evaluated in-process.
+cat > $TMP.recipe <<'EOF'
+i=0
+while test $i -lt $N; do
+  dir=out/obj/src/lib$i
+  test -d "$dir" || : mkdir -p "$dir"
+  src=src/lib/file$i.c
+  obj=$dir/${src##*/}
+  obj=${obj%.c}.o
+  echo "kBuild: Compiling lib - $src" > /dev/null
+  case $obj in
+    *.o) : ;;
+    *) exit 1 ;;
+  esac
+  eval "DEP_$i=\$obj"
+  i=$((i + 1))
+done
+EOF
+
+# Command lookup along a long PATH, with the hash table flushed.
+cat > $TMP.lookup <<'EOF'
+PATH=/nonexistent/1:/nonexistent/2:/nonexistent/3:/nonexistent/4:$PATH
+i=0
+while test $i -lt $N; do
+  hash -r
+  command -v cat > /dev/null
+  command -v sed > /dev/null
+  i=$((i + 1))
+done
+EOF
+
+# Fork and exec of an external command, and a subshell.
+cat > $TMP.fork <<'EOF'
+i=0
+while test $i -lt $N; do
+  /bin/true
+  (:)
+  i=$((i + 1))
+done
+EOF
+
+# Parameter expansion, field splitting and arithmetic.
+cat > $TMP.expand <<'EOF'
+words="src/a.c src/b.c src/c.c src/sub/d.c src/sub/e.c src/sub/f.c src/g.c"
+i=0
+while test $i -lt $N; do
+  n=0
+  for w in $words $words $words; do
+    b=${w##*/}
+    d=${w%/*}
+    x="$d/${b%.c}.o"
+    n=$((n + ${#x}))
+  done
+  set -- $words
+  IFS=/; set -- $*; IFS=' '
+  i=$((i + 1))
+done
+EOF
+
+run ()
+{
+  name=$1; n=$2; shift 2
+  for sh in "$KASH" $OTHER; do
+    ms=`(
+      if test "$name" = startup; then
+        startup $n "$sh"
+      else
+        N=$n "$sh" "$@" > /dev/null || exit 1
+      fi
+      times
+    ) | awk 'NR == 2 { split($1, u, "m"); split($2, s, "m");
+                       printf "%d", (u[1] * 60 + u[2] + s[1] * 60 + s[2]) * 1000 }'`
+    test -n "$ms" || exit 1
+    printf "%-10s %-48s %6d ms\n" "$name" "$sh" $ms
+  done
+  if test -n "$KASH_BENCH_STATS" -a "$name" != startup; then
+    N=$n "$KASH" --stats "$@"
+  fi
+}
+
+run startup $((200 * SCALE))
+run recipe  $((20000 * SCALE)) $TMP.recipe
+run lookup  $((5000 * SCALE)) $TMP.lookup
+run fork    $((500 * SCALE)) $TMP.fork
+run expand  $((5000 * SCALE)) $TMP.expand
+exit 0
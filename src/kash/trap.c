@@ -452,6 +452,8 @@ exitshell(shinstance *psh, int status)
 		evalstring(psh, p, 0);
 	}
 l1:   psh->handler = &loc2;			/* probably unnecessary */
+	if (statsflag(psh) == 1 && psh->rootshell) /* 2 if procargs failed */
+		printstats(psh);
 	output_flushall(psh);
 #if JOBS
 	setjobctl(psh, 0);
@@ -176,7 +176,14 @@ const struct varinit varinit[] = {
 //struct var *vartab[VTABSIZE];
 
 STATIC int strequal(const char *, const char *);
+STATIC unsigned int hashvar(const char *, int *);
 STATIC struct var *find_var(shinstance *, const char *, struct var ***, int *);
+STATIC struct var *find_lazy_var(shinstance *, const char *, int, unsigned int, struct var **);
+STATIC void import_lazy_vars(shinstance *);
+STATIC void flushenvcache(shinstance *);
+
+/* envlazy entry of a variable that has been imported since. */
+static char envlazy_gone[] = "";
 
 /*
  * Initialize the varable symbol tables and import the environment
@@ -186,16 +193,60 @@ STATIC struct var *find_var(shinstance *, const char *, struct var ***, int *);
 INCLUDE "var.h"
 
 INIT {
+	initvar(psh);
+	importenv(psh);
+}
+#endif
+
+
+/*
+ * Import the environment.  Variables set up by initvar are imported
+ * right away so their callbacks are run, the rest is left in an open
+ * addressed table and only turned into variables when find_var looks
+ * them up.  Shells run by kmk inherit large environments and rarely
+ * look at more than a handful of the entries.
+ */
+
+void
+importenv(shinstance *psh)
+{
 	char **envp;
+	char **tab;
+	char *s;
+	unsigned int mask;
+	unsigned int i;
+	int len;
 
-	initvar(psh);
+	for (i = 0, envp = sh_environ(psh) ; *envp ; envp++)
+		i++;
+	for (mask = 15; mask < i * 2; mask = mask * 2 + 1)
+		continue;
+	tab = ckmalloc(psh, (mask + 1) * sizeof(*tab));
+	memset(tab, 0, (mask + 1) * sizeof(*tab));
+
+	psh->envlazyleft = 0;
 	for (envp = sh_environ(psh) ; *envp ; envp++) {
-		if (strchr(*envp, '=')) {
+		if (!strchr(*envp, '='))
+			continue;
+		if (find_var(psh, *envp, NULL, NULL) != NULL) {
 			setvareq(psh, *envp, VEXPORT|VTEXTFIXED);
+			continue;
 		}
+		/* A later entry with the same name wins, like setvareq would. */
+		for (i = hashvar(*envp, &len) & mask; (s = tab[i]) != NULL; i = (i + 1) & mask)
+			if (strncmp(s, *envp, len + 1) == 0)
+				break;
+		if (s == NULL)
+			psh->envlazyleft++;
+		tab[i] = *envp;
 	}
+
+	if (psh->envlazyleft) {
+		psh->envlazy = tab;
+		psh->envlazymask = mask;
+	} else
+		ckfree(psh, tab);
 }
-#endif
 
 
 /*
@@ -372,6 +423,8 @@ setvareq(shinstance *psh, char *s, int flags)
 		if (flags & VNOSET)
 			return;
 		INTOFF;
+		if ((vp->flags | flags) & VEXPORT)
+			flushenvcache(psh);
 
 		if (vp->func && (flags & VNOFUNC) == 0)
 			(*vp->func)(psh, s + vp->name_len + 1);
@@ -413,6 +466,8 @@ setvareq(shinstance *psh, char *s, int flags)
     }
 #endif
 
+	if (flags & VEXPORT)
+		flushenvcache(psh);
 	vp = ckmalloc(psh, sizeof (*vp));
 	vp->flags = flags & ~VNOFUNC;
 	vp->text = s;
@@ -495,7 +550,8 @@ bltinlookup(shinstance *psh, const char *name, int doall)
 
 /*
  * Generate a list of exported variables.  This routine is used to construct
- * the third argument to execve when executing a program.
+ * the third argument to execve when executing a program.  The list is kept
+ * until an exported variable changes, so the caller must not modify it.
  */
 
 char **
@@ -506,20 +562,30 @@ environment(shinstance *psh)
 	struct var *vp;
 	char **env;
 	char **ep;
-
-	nenv = 0;
-	for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
-		for (vp = *vpp ; vp ; vp = vp->next)
-			if (vp->flags & VEXPORT)
-				nenv++;
-	}
-	ep = env = stalloc(psh, (nenv + 1) * sizeof *env);
-	for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
-		for (vp = *vpp ; vp ; vp = vp->next)
-			if (vp->flags & VEXPORT)
-				*ep++ = vp->text;
+	unsigned int i;
+
+	env = psh->envcache;
+	if (env == NULL) {
+		nenv = psh->envlazyleft;
+		for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
+			for (vp = *vpp ; vp ; vp = vp->next)
+				if (vp->flags & VEXPORT)
+					nenv++;
+		}
+		ep = env = ckmalloc(psh, (nenv + 1) * sizeof *env);
+		for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
+			for (vp = *vpp ; vp ; vp = vp->next)
+				if (vp->flags & VEXPORT)
+					*ep++ = vp->text;
+		}
+		if (psh->envlazy) {
+			for (i = 0; i <= psh->envlazymask; i++)
+				if (psh->envlazy[i] && psh->envlazy[i] != envlazy_gone)
+					*ep++ = psh->envlazy[i];
+		}
+		*ep = NULL;
+		psh->envcache = env;
 	}
-	*ep = NULL;
 
 #ifdef PC_OS2_LIBPATHS
 	/*
@@ -553,6 +619,7 @@ shprocvar(shinstance *psh)
 	struct var **vpp;
 	struct var *vp, **prev;
 
+	flushenvcache(psh);
 	for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
 		for (prev = vpp ; (vp = *prev) != NULL ; ) {
 			if ((vp->flags & VEXPORT) == 0) {
@@ -640,6 +707,7 @@ showvars(shinstance *psh, const char *name, int flag, int show_value)
 		list = ckmalloc(psh, list_len * sizeof(*list));
 	}
 
+	import_lazy_vars(psh);
 	for (vpp = psh->vartab ; vpp < psh->vartab + VTABSIZE ; vpp++) {
 		for (vp = *vpp ; vp ; vp = vp->next) {
 			if (flag && !(vp->flags & flag))
@@ -699,6 +767,8 @@ exportcmd(shinstance *psh, int argc, char **argv)
 		} else {
 			vp = find_var(psh, name, NULL, NULL);
 			if (vp != NULL) {
+				if (flag == VEXPORT)
+					flushenvcache(psh);
 				vp->flags |= flag;
 				continue;
 			}
@@ -793,6 +863,8 @@ poplocalvars(shinstance *psh)
 		} else if ((lvp->flags & (VUNSET|VSTRFIXED)) == VUNSET) {
 			(void)unsetvar(psh, vp->text, 0);
 		} else {
+			if ((vp->flags | lvp->flags) & VEXPORT)
+				flushenvcache(psh);
 			if (vp->func && (vp->flags & VNOFUNC) == 0)
 				(*vp->func)(psh, lvp->text + vp->name_len + 1);
 			if ((vp->flags & VTEXTFIXED) == 0)
@@ -870,6 +942,8 @@ unsetvar(shinstance *psh, const char *s, int unexport)
 		return (1);
 
 	INTOFF;
+	if (vp->flags & VEXPORT)
+		flushenvcache(psh);
 	if (unexport) {
 		vp->flags &= ~VEXPORT;
 	} else {
@@ -907,6 +981,28 @@ strequal(const char *p, const char *q)
 	return 0;
 }
 
+/*
+ * Hash a variable name, which may be terminated by '=' or a NUL.
+ * lenp is set to the number of characters in the name.
+ */
+
+STATIC unsigned int
+hashvar(const char *name, int *lenp)
+{
+	unsigned int hashval;
+	const char *p = name;
+
+	hashval = 0;
+	while (*p && *p != '=')
+		hashval = 31 * hashval + (unsigned char)*p++;
+	*lenp = (int)(p - name);
+	/* Mix it up so names differing only at the end don't cluster. */
+	hashval ^= hashval >> 16;
+	hashval *= 0x85ebca6bU;
+	hashval ^= hashval >> 13;
+	return hashval;
+}
+
 /*
  * Search for a variable.
  * 'name' may be terminated by '=' or a NUL.
@@ -919,13 +1015,9 @@ find_var(shinstance *psh, const char *name, struct var ***vppp, int *lenp)
 {
 	unsigned int hashval;
 	int len;
-	struct var *vp, **vpp;
-	const char *p = name;
+	struct var *vp, **vpp, **head;
 
-	hashval = 0;
-	while (*p && *p != '=')
-		hashval = 2 * hashval + (unsigned char)*p++;
-	len = (int)(p - name);
+	hashval = hashvar(name, &len);
 
 #ifdef PC_MIXED_PATH_VAR_NAME
     /* On Windows the PATH variable is called "Path". */
@@ -936,16 +1028,13 @@ find_var(shinstance *psh, const char *name, struct var ***vppp, int *lenp)
         && (name[3] == 'h' || name[3] == 'H') )
     {
         name = "PATH";
-		hashval = (unsigned char)'P';
-		hashval = hashval * 2 + (unsigned char)'A';
-		hashval = hashval * 2 + (unsigned char)'T';
-		hashval = hashval * 2 + (unsigned char)'H';
+		hashval = hashvar(name, &len);
     }
 #endif
 
 	if (lenp)
 		*lenp = len;
-	vpp = &psh->vartab[hashval % VTABSIZE];
+	vpp = head = &psh->vartab[hashval % VTABSIZE];
 	if (vppp)
 		*vppp = vpp;
 
@@ -958,5 +1047,76 @@ find_var(shinstance *psh, const char *name, struct var ***vppp, int *lenp)
 			*vppp = vpp;
 		return vp;
 	}
+	if (psh->envlazy)
+		return find_lazy_var(psh, name, len, hashval, head);
 	return NULL;
 }
+
+/*
+ * Look for a variable in the part of the environment that has not been
+ * imported yet, importing it at the head of the given hash list if found.
+ */
+
+STATIC struct var *
+find_lazy_var(shinstance *psh, const char *name, int len, unsigned int hashval,
+    struct var **vpp)
+{
+	char **tab = psh->envlazy;
+	unsigned int mask = psh->envlazymask;
+	unsigned int i;
+	struct var *vp;
+	char *s;
+
+	for (i = hashval & mask; (s = tab[i]) != NULL; i = (i + 1) & mask)
+		if (s != envlazy_gone && strncmp(s, name, len) == 0 && s[len] == '=')
+			break;
+	if (s == NULL)
+		return NULL;
+
+	INTOFF;
+	vp = ckmalloc(psh, sizeof (*vp));
+	vp->flags = VEXPORT|VTEXTFIXED;
+	vp->text = s;
+	vp->name_len = len;
+	vp->next = *vpp;
+	vp->func = NULL;
+	*vpp = vp;
+	tab[i] = envlazy_gone;
+	if (--psh->envlazyleft == 0) {
+		psh->envlazy = NULL;
+		ckfree(psh, tab);
+	}
+	INTON;
+	return vp;
+}
+
+/*
+ * Import whatever is left of the environment, for when all the variables
+ * have to be walked.
+ */
+
+STATIC void
+import_lazy_vars(shinstance *psh)
+{
+	unsigned int i;
+	char *s;
+
+	for (i = 0; psh->envlazy && i <= psh->envlazymask; i++) {
+		s = psh->envlazy[i];
+		if (s && s != envlazy_gone)
+			(void)find_var(psh, s, NULL, NULL);
+	}
+}
+
+/*
+ * Drop the cached environment() vector after an exported variable changed.
+ */
+
+STATIC void
+flushenvcache(shinstance *psh)
+{
+	if (psh->envcache) {
+		ckfree(psh, psh->envcache);
+		psh->envcache = NULL;
+	}
+}
@@ -126,6 +126,7 @@ extern struct var vhistsize;
 #define mpathset(psh)	(((psh)->vmpath.flags & VUNSET) == 0)
 
 void initvar(struct shinstance *);
+void importenv(struct shinstance *);
 void setvar(struct shinstance *, const char *, const char *, int);
 void setvareq(struct shinstance *, char *, int);
 struct strlist;
@@ -109,6 +109,11 @@ void free_dep_chain (struct dep *d);
 void free_ns_chain (struct nameseq *n);
 struct dep *read_all_makefiles (const char **makefiles);
 void eval_buffer (char *buffer IF_WITH_VALUE_LENGTH(COMMA char *eos));
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+void eval_kbuild_rule (char *targets, char *depstr, const char *commands,
+                       unsigned int commands_idx);
+void eval_kbuild_target_var (char *targets, char *defn);
+#endif
 int update_goal_chain (struct dep *goals);
 
 #ifdef CONFIG_WITH_INCLUDEDEP
@@ -250,6 +250,9 @@ struct directory_contents
 #endif /* WINDOWS32 */
     struct hash_table dirfiles;	/* Files in this directory.  */
     DIR *dirstream;		/* Stream reading this directory.  */
+#ifdef CONFIG_WITH_GLOB_CACHE
+    unsigned int generation;	/* Incremented when DIRFILES changes.  */
+#endif
   };
 
 static unsigned long
@@ -635,6 +638,9 @@ find_directory (const char *name)
 # endif
 #endif /* WINDOWS32 */
 	      hash_insert_at (&directory_contents, dc, dc_slot);
+#ifdef CONFIG_WITH_GLOB_CACHE
+              dc->generation = 0;
+#endif
 	      ENULLLOOP (dc->dirstream, opendir (name));
 	      if (dc->dirstream == 0)
                 /* Couldn't open the directory.  Mark this by setting the
@@ -860,6 +866,9 @@ dir_contents_file_exists_p (struct directory_contents *dir,
 	  df->length = len;
 	  df->impossible = 0;
 	  hash_insert_at (&dir->dirfiles, df, dirfile_slot);
+#ifdef CONFIG_WITH_GLOB_CACHE
+          dir->generation++;
+#endif
 	}
       /* Check if the name matches the one we're searching for.  */
 #ifndef CONFIG_WITH_STRCACHE2
@@ -1055,6 +1064,9 @@ file_impossible (const char *filename)
 #else  /* CONFIG_WITH_STRCACHE2 */
   hash_insert_strcached (&dir->contents->dirfiles, new);
 #endif /* CONFIG_WITH_STRCACHE2 */
+#ifdef CONFIG_WITH_GLOB_CACHE
+  dir->contents->generation++;
+#endif
 }
 
 /* Return nonzero if FILENAME has been marked impossible.  */
@@ -1154,6 +1166,286 @@ dir_name (const char *dir)
   return find_directory (dir)->name;
 }
 
+#ifdef CONFIG_WITH_GLOB_CACHE
+# ifndef CONFIG_WITH_STRCACHE2
+#  error "CONFIG_WITH_GLOB_CACHE requires CONFIG_WITH_STRCACHE2"
+# endif
+
+/* The glob cache.
+
+   Makefiles tend to glob the same patterns over and over again, like
+   $(wildcard $(PATH_SUB_CURRENT)/*.c), and each time glob walks all the
+   cached entries of the directory and fnmatch's them.  The result of a
+   pattern with wildcards in the last component only depends on what the
+   directory cache knows about that one directory, so we remember it until
+   the generation of the directory contents changes.  Patterns with
+   wildcards elsewhere and plain names are left to glob, the latter are
+   checked against the file system and not the directory cache.  */
+
+struct glob_cache_entry
+  {
+    const char *pattern;        /* The pattern (strcache'ed), the key.  */
+    struct directory *dir;      /* The directory the pattern globs.  */
+    struct directory_contents *contents; /* DIR->contents when globbed.  */
+    unsigned int generation;    /* CONTENTS->generation when globbed.  */
+    unsigned int count;         /* Number of matches, 0 if none.  */
+    const char **names;         /* The matches (strcache'ed), glob order.  */
+  };
+
+static struct hash_table glob_cache;
+static unsigned long glob_cache_hits;
+static unsigned long glob_cache_misses;
+
+/* Checks if PATTERN can be cached.  Returns the length of the directory
+   part (excluding the final slash), -1 if there is no directory part and
+   -2 if PATTERN cannot be cached.  */
+
+static int
+glob_cache_dir_len (const char *pattern)
+{
+  const char *slash = 0;
+  const char *p;
+  int meta = 0;
+
+  for (p = pattern; *p != '\0'; p++)
+    switch (*p)
+      {
+        case '/':
+          if (meta)
+            return -2;
+          slash = p;
+          break;
+        case '*':
+        case '?':
+          meta = 1;
+          break;
+        case '[':
+          if (strchr (p + 1, ']'))
+            meta = 1;
+          break;
+        case '\\':
+#ifdef HAVE_DOS_PATHS
+        case ':':
+#endif
+          return -2;
+      }
+  if (!meta)
+    return -2;
+  return slash ? slash - pattern : -1;
+}
+
+/* Looks up PATTERN in the glob cache.  Returns 1 and sets *COUNTP and
+   *NAMESP if found and still valid, 0 if PATTERN must be globbed.  */
+
+int
+dir_glob_cache_lookup (const char *pattern, int *countp, const char ***namesp)
+{
+  struct glob_cache_entry key;
+  struct glob_cache_entry *entry;
+
+  if (glob_cache_dir_len (pattern) == -2)
+    return 0;
+
+  key.pattern = strcache_add (pattern);
+  entry = hash_find_item_strcached (&glob_cache, &key);
+  if (entry
+      && entry->dir->contents == entry->contents
+      && (!entry->contents || entry->contents->generation == entry->generation))
+    {
+      glob_cache_hits++;
+      *countp = entry->count;
+      *namesp = entry->names;
+      return 1;
+    }
+  glob_cache_misses++;
+  return 0;
+}
+
+/* Enters the COUNT matches in NAMES of globbing PATTERN into the glob
+   cache, if PATTERN is something we can cache.  */
+
+void
+dir_glob_cache_store (const char *pattern, unsigned int count, char **names)
+{
+  struct glob_cache_entry key;
+  struct glob_cache_entry *entry;
+  struct glob_cache_entry **slot;
+  struct directory *dir;
+  unsigned int i;
+  int dir_len;
+
+  dir_len = glob_cache_dir_len (pattern);
+  if (dir_len == -2)
+    return;
+  if (dir_len == -1)
+    dir = find_directory (".");
+  else if (dir_len == 0)
+    dir = find_directory ("/");
+  else
+    {
+      char *dirname = alloca (dir_len + 1);
+      memcpy (dirname, pattern, dir_len);
+      dirname[dir_len] = '\0';
+      dir = find_directory (dirname);
+    }
+
+  key.pattern = strcache_add (pattern);
+  slot = (struct glob_cache_entry **) hash_find_slot_strcached (&glob_cache, &key);
+  entry = *slot;
+  if (HASH_VACANT (entry))
+    {
+      entry = xmalloc (sizeof (*entry));
+      entry->pattern = key.pattern;
+      hash_insert_at (&glob_cache, entry, slot);
+    }
+  else
+    free (entry->names);
+
+  entry->dir = dir;
+  entry->contents = dir->contents;
+  entry->generation = dir->contents ? dir->contents->generation : 0;
+  entry->count = count;
+  entry->names = xmalloc ((count ? count : 1) * sizeof (const char *));
+  for (i = 0; i < count; i++)
+    entry->names[i] = strcache_add (names[i]);
+}
+#endif /* CONFIG_WITH_GLOB_CACHE */
+
+#ifdef CONFIG_WITH_VPATH_INDEX
+# ifndef CONFIG_WITH_STRCACHE2
+#  error "CONFIG_WITH_VPATH_INDEX requires CONFIG_WITH_STRCACHE2"
+# endif
+
+/* The directory index.
+
+   A vpath search for a plain file name used to build each candidate
+   path and ask the directory cache about it, which means hashing the
+   directory name, the file name and the combined path once per vpath
+   directory.  The index reads all the directories of a search path in
+   one go and maps each file name to the first directory containing it.
+
+   Once a directory has been read completely, the only change the cache
+   sees is a name being marked impossible by file_impossible.  That is
+   checked when the index answers, and the search continues with the
+   following directories if needed.  The index is not used on systems
+   where the directory cache is refreshed (Windows) or where file names
+   get mangled before looking them up in the cache.  */
+
+struct dir_index_entry
+  {
+    const char *name;           /* The file name (strcache'ed), the key.  */
+    unsigned int dir;           /* Index of the first directory having it.  */
+  };
+
+struct dir_index
+  {
+    unsigned int count;         /* Number of directories.  */
+    struct directory_contents **contents; /* The directory contents.  */
+    struct hash_table names;    /* struct dir_index_entry by name.  */
+  };
+
+/* Create an index of the files in the null-terminated directory list
+   DIRS, which must stay around for as long as the index.  */
+
+struct dir_index *
+dir_index_create (const char **dirs)
+{
+  struct dir_index *index = xmalloc (sizeof (*index));
+  unsigned int i;
+
+  for (i = 0; dirs[i] != 0; i++)
+    ;
+  index->count = i;
+  index->contents = xmalloc ((i ? i : 1) * sizeof (index->contents[0]));
+  hash_init_strcached (&index->names, 1024, &file_strcache,
+                       offsetof (struct dir_index_entry, name));
+
+  for (i = 0; i < index->count; i++)
+    {
+      struct directory_contents *dc = find_directory (dirs[i])->contents;
+      struct dirfile **slot;
+      struct dirfile **end;
+
+      index->contents[i] = dc;
+      if (dc == 0 || dc->dirfiles.ht_vec == 0)
+        continue;
+
+      /* Read the rest of the directory.  */
+      dir_contents_file_exists_p (dc, 0);
+
+      slot = (struct dirfile **) dc->dirfiles.ht_vec;
+      end = slot + dc->dirfiles.ht_size;
+      for (; slot < end; slot++)
+        if (!HASH_VACANT (*slot) && !(*slot)->impossible)
+          {
+            struct dir_index_entry key;
+            struct dir_index_entry **entry_slot;
+
+            key.name = (*slot)->name;
+            entry_slot = (struct dir_index_entry **)
+              hash_find_slot_strcached (&index->names, &key);
+            if (HASH_VACANT (*entry_slot))
+              {
+                struct dir_index_entry *entry = xmalloc (sizeof (*entry));
+                entry->name = key.name;
+                entry->dir = i;
+                hash_insert_at (&index->names, entry, entry_slot);
+              }
+          }
+    }
+
+  return index;
+}
+
+void
+dir_index_free (struct dir_index *index)
+{
+  hash_free (&index->names, 1);
+  free (index->contents);
+  free (index);
+}
+
+/* Checks if the directory cache has FILENAME (without slashes) as a
+   possible file in DC.  */
+
+static int
+dir_index_has_file (struct directory_contents *dc, const char *filename)
+{
+  struct dirfile key;
+  struct dirfile *df;
+
+  if (dc == 0 || dc->dirfiles.ht_vec == 0)
+    return 0;
+  key.name = filename;
+  df = hash_find_item_strcached (&dc->dirfiles, &key);
+  return df != 0 && !df->impossible;
+}
+
+/* Returns the index of the first directory in INDEX that has FILENAME
+   (without slashes) according to the directory cache, or -1 if none.  */
+
+int
+dir_index_lookup (struct dir_index *index, const char *filename)
+{
+  struct dir_index_entry key;
+  struct dir_index_entry *entry;
+  unsigned int i;
+
+  /* If the string cache doesn't know the name, no directory has it.  */
+  key.name = strcache2_lookup_file (&file_strcache, filename, strlen (filename));
+  if (key.name == 0)
+    return -1;
+  entry = hash_find_item_strcached (&index->names, &key);
+  if (entry == 0)
+    return -1;
+
+  for (i = entry->dir; i < index->count; i++)
+    if (dir_index_has_file (index->contents[i], key.name))
+      return i;
+  return -1;
+}
+#endif /* CONFIG_WITH_VPATH_INDEX */
+
 /* Print the data base of directories.  */
 
 void
@@ -1273,6 +1565,12 @@ print_dir_data_base (void)
   hash_print_stats (&directory_contents, stdout);
   fputs ("\n", stdout);
 #endif
+#ifdef CONFIG_WITH_GLOB_CACHE
+  printf (_("# glob cache: %lu patterns, %lu hits, %lu misses; "),
+          glob_cache.ht_fill, glob_cache_hits, glob_cache_misses);
+  hash_print_stats (&glob_cache, stdout);
+  fputs ("\n", stdout);
+#endif
 }
 
 /* Hooks for globbing.  */
@@ -1424,4 +1722,8 @@ hash_init_directories (void)
   alloccache_init (&dirfile_cache, sizeof (struct dirfile),
                    "dirfile", NULL, NULL);
 #endif /* CONFIG_WITH_ALLOC_CACHES */
+#ifdef CONFIG_WITH_GLOB_CACHE
+  hash_init_strcached (&glob_cache, 64, &file_strcache,
+                       offsetof (struct glob_cache_entry, pattern));
+#endif
 }
@@ -299,6 +299,14 @@ rehash_file (struct file *from_file, const char *to_hname)
     /* hname changed unexpectedly!! */
     abort ();
 
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+  /* Do the second expansion of the prerequisites snap_deps left for later
+     while the file still has its old name, like snap_deps would have.
+     Nobody looks for pending prerequisites on a renamed file.  */
+  if (from_file->deps_pending)
+    expand_pending_deps (from_file);
+#endif
+
   /* Remove the "from" file from the hash.  */
 #ifndef CONFIG_WITH_STRCACHE2
   deleted_file = hash_delete (&files, from_file);
@@ -711,6 +719,7 @@ expand_deps (struct file *f)
           d->name = name = xstrdup (variable_buffer); /* bird not d->name, can be reallocated */
 #else
           d->name = strcache2_add (&file_strcache, variable_buffer, o - variable_buffer);
+          name = NULL; /* already freed above, the strcache owns d->name. */
 #endif
           d->staticpattern = 0;
         }
@@ -767,6 +776,53 @@ expand_deps (struct file *f)
     }
 }
 
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+/* Does the second expansion of the prerequisites of F which snap_deps put
+   off.  This is called when F is first considered for updating, so the
+   prerequisites of targets that aren't on the way to any goal are never
+   expanded.  The expansion sees the variables as they are at that point,
+   so a $(eval) in the recipe of a target considered earlier affects it,
+   unlike when snap_deps did the expansion right after reading the
+   makefiles.  Unlike the snap_deps case, F may be in the middle of being
+   updated, so the updating flag must be left alone.  */
+
+void
+expand_pending_deps (struct file *f)
+{
+  unsigned int updating = f->updating;
+  struct dep *d;
+
+  f->deps_pending = 0;
+  expand_deps (f);
+  f->updating = updating;
+
+  /* Files entered by the expansion weren't around when .SECONDARY without
+     prerequisites marked all files as intermediate.  */
+  if (all_secondary)
+    for (d = f->deps; d != 0; d = d->next)
+      d->file->intermediate = 1;
+}
+
+/* Does the pending second expansion of all files, so the data base
+   printout shows the prerequisites that would be used and not the
+   unexpanded text.  */
+
+static void
+expand_all_pending_deps (void)
+{
+  struct file **file_slot_0 = (struct file **) hash_dump (&files, 0, 0);
+  struct file **file_end = file_slot_0 + files.ht_fill;
+  struct file **file_slot;
+  struct file *f;
+
+  for (file_slot = file_slot_0; file_slot < file_end; file_slot++)
+    for (f = *file_slot; f != 0; f = f->prev)
+      if (f->deps_pending)
+        expand_pending_deps (f);
+  free (file_slot_0);
+}
+#endif /* CONFIG_WITH_LAZY_2ND_EXPANSION */
+
 /* Reset the updating flag.  */
 
 static void
@@ -870,6 +926,7 @@ snap_deps (void)
 
       /* For every target that's not .SUFFIXES, expand its prerequisites.  */
 
+#ifndef CONFIG_WITH_LAZY_2ND_EXPANSION
       for (file_slot = file_slot_0; file_slot < file_end; file_slot++)
         for (f = *file_slot; f != 0; f = f->prev)
           if (f->name != suffixes)
@@ -879,6 +936,31 @@ snap_deps (void)
   else
     /* We're not doing second expansion, so reset updating.  */
     hash_map (&files, reset_updating);
+#else  /* CONFIG_WITH_LAZY_2ND_EXPANSION */
+      /* Only the special targets are needed right away (see below), the
+         rest are expanded by expand_pending_deps when update_file gets
+         to them.  A typical kBuild makefile has thousands of targets with
+         $$(dir $$@) style prerequisites while a build usually only
+         considers a fraction of them.  */
+      for (file_slot = file_slot_0; file_slot < file_end; file_slot++)
+        for (f = *file_slot; f != 0; f = f->prev)
+          if (f->name != suffixes)
+            {
+              if (f->name[0] == '.' && isupper ((unsigned char)f->name[1]))
+                expand_deps (f);
+              else
+                {
+                  for (d = f->deps; d != 0; d = d->next)
+                    if (d->name && d->need_2nd_expansion)
+                      break;
+                  f->deps_pending = d != 0;
+                }
+            }
+      free (file_slot_0);
+    }
+
+  hash_map (&files, reset_updating);
+#endif /* CONFIG_WITH_LAZY_2ND_EXPANSION */
 
   /* Now manage all the special targets.  */
 
@@ -1264,6 +1346,9 @@ print_file (const void *item)
 void
 print_file_data_base (void)
 {
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+  expand_all_pending_deps ();
+#endif
   puts (_("\n# Files"));
 
   hash_map (&files, print_file);
@@ -118,6 +118,11 @@ struct file
                                   second expansion of its name. Whether it
                                   can receive this is decided at parse time,
                                   and the expanding done in snap_deps. */
+#endif
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+    unsigned int deps_pending:1; /* Nonzero if the second expansion of the
+                                   prerequisites has been put off until the
+                                   file is considered for updating. */
 #endif
   };
 
@@ -134,6 +139,9 @@ struct dep *split_prereqs (char *prereqstr);
 struct dep *enter_prereqs (struct dep *prereqs, const char *stem);
 void remove_intermediates (int sig);
 void snap_deps (void);
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+void expand_pending_deps (struct file *f);
+#endif
 void rename_file (struct file *file, const char *name);
 void rehash_file (struct file *file, const char *name);
 void set_command_state (struct file *file, enum cmd_state state);
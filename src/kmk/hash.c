@@ -19,6 +19,15 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifdef CONFIG_WITH_STRCACHE2
 # include <assert.h>
 #endif
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+# ifndef CONFIG_WITH_STRCACHE2
+#  error "CONFIG_WITH_HASH_CTRL_BYTES requires CONFIG_WITH_STRCACHE2"
+# endif
+# if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define HASH_CTRL_SSE2
+# endif
+#endif
 
 
 #define	CALLOC(t, n) ((t *) calloc (sizeof (t), (n)))
@@ -38,6 +47,138 @@ static unsigned long round_up_2 __P((unsigned long rough));
 
 void *hash_deleted_item = &hash_deleted_item;
 
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+/* Tables created by hash_init_strcached get a control byte array in
+   addition to the item vector, in the manner of the Swiss tables.  Each
+   slot has a byte saying whether it is empty, deleted or full, and for
+   full slots the byte holds a 7-bit tag derived from the key.  Lookups
+   probe sixteen control bytes at a time and only dereference the items
+   whose tag matches, which saves a cache miss per collision.
+
+   Probing starts at the slot given by the pointer hash, keeping the
+   locality the plain double hashing has for strings allocated one after
+   the other.  Since such strings fill long runs of slots, a search that
+   fails at the first group moves on by an odd number of whole groups
+   taken from the string hash, like the secondary hash does for single
+   slots, so it leaves the run right away.  The group loads are unaligned, so
+   the first HASH_CTRL_GROUP - 1 control bytes are mirrored after the
+   end of the array to avoid special casing the wrap around.  A group
+   containing an empty slot terminates the search, which is why the
+   loading factor is lowered to 87.5% for these tables.
+
+   The item vector is kept exactly as before (NULL for empty slots and
+   hash_deleted_item for deleted ones), so code walking ht_vec directly
+   continues to work.  Tables smaller than a group go without.  */
+
+# define HASH_CTRL_EMPTY    0x80
+# define HASH_CTRL_DELETED  0xfe
+
+/* The tag and the probe increment come from the string hash kept by the
+   string cache, as the pointer hash says little about keys sharing a
+   group.  */
+# define HASH_CTRL_TAG(hash)  ((unsigned char)((hash) & 0x7f))
+# define HASH_CTRL_STEP(hash) ((((hash) >> 7) | 1) * HASH_CTRL_GROUP)
+
+static void
+hash_ctrl_alloc (struct hash_table *ht)
+{
+  ht->ht_ctrl = (unsigned char *) xmalloc (HASH_CTRL_SIZE (ht->ht_size));
+  memset (ht->ht_ctrl, HASH_CTRL_EMPTY, HASH_CTRL_SIZE (ht->ht_size));
+}
+
+MY_INLINE void
+hash_ctrl_set (struct hash_table *ht, unsigned long idx, unsigned char ctrl)
+{
+  ht->ht_ctrl[idx] = ctrl;
+  if (idx < HASH_CTRL_GROUP - 1)
+    ht->ht_ctrl[ht->ht_size + idx] = ctrl;
+}
+
+/* Returns a bit mask of the bytes in the group at CTRL that equals C.  */
+MY_INLINE unsigned int
+hash_ctrl_match (const unsigned char *ctrl, unsigned char c)
+{
+# ifdef HASH_CTRL_SSE2
+  __m128i group = _mm_loadu_si128 ((const __m128i *) ctrl);
+  return (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (group, _mm_set1_epi8 ((char) c)));
+# else
+  unsigned int mask = 0;
+  unsigned int i;
+  for (i = 0; i < HASH_CTRL_GROUP; i++)
+    if (ctrl[i] == c)
+      mask |= 1U << i;
+  return mask;
+# endif
+}
+
+MY_INLINE unsigned int
+hash_ctrl_first_bit (unsigned int mask)
+{
+# if defined (__GNUC__)
+  return __builtin_ctz (mask);
+# else
+  unsigned int i = 0;
+  while (!(mask & 1))
+    {
+      mask >>= 1;
+      i++;
+    }
+  return i;
+# endif
+}
+
+/* hash_find_slot_strcached for tables with control bytes.  */
+static void **
+hash_ctrl_find_slot (struct hash_table *ht, const char *str)
+{
+  unsigned int str_hash = strcache2_get_hash (ht->ht_strcache, str);
+  unsigned char tag = HASH_CTRL_TAG (str_hash);
+  unsigned long mask = ht->ht_size - 1;
+  unsigned long pos = strcache2_calc_ptr_hash (ht->ht_strcache, str) & mask;
+  void **deleted_slot = 0;
+
+  for (;;)
+    {
+      const unsigned char *group = &ht->ht_ctrl[pos];
+      unsigned int bits = hash_ctrl_match (group, tag);
+
+      while (bits)
+        {
+          unsigned long idx = (pos + hash_ctrl_first_bit (bits)) & mask;
+          const char *str2 = *(const char **)((const char *)ht->ht_vec[idx] + ht->ht_off_string);
+          if (str == str2)
+            return &ht->ht_vec[idx];
+          MAKE_STATS (ht->ht_collisions++);
+          MAKE_STATS_3 (make_stats_ht_collisions++);
+          bits &= bits - 1;
+        }
+
+      if (!deleted_slot)
+        {
+          bits = hash_ctrl_match (group, HASH_CTRL_DELETED);
+          if (bits)
+            deleted_slot = &ht->ht_vec[(pos + hash_ctrl_first_bit (bits)) & mask];
+        }
+
+      bits = hash_ctrl_match (group, HASH_CTRL_EMPTY);
+      if (bits)
+        return deleted_slot ? deleted_slot
+                            : &ht->ht_vec[(pos + hash_ctrl_first_bit (bits)) & mask];
+
+      pos = (pos + HASH_CTRL_STEP (str_hash)) & mask;
+    }
+}
+
+/* Updates the control byte of SLOT after ITEM was stored in it.  */
+MY_INLINE void
+hash_ctrl_store (struct hash_table *ht, const void *item, void **slot)
+{
+  const char *str = *(const char **)((const char *)item + ht->ht_off_string);
+  hash_ctrl_set (ht, slot - ht->ht_vec,
+                 HASH_CTRL_TAG (strcache2_get_hash (ht->ht_strcache, str)));
+}
+#endif /* CONFIG_WITH_HASH_CTRL_BYTES */
+
 /* Force the table size to be a power of two, possibly rounding up the
    given size.  */
 
@@ -67,6 +208,10 @@ hash_init (struct hash_table *ht, unsigned long size,
   ht->ht_strcache = 0;
   ht->ht_off_string = 0;
 #endif
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  ht->ht_ctrl = 0;
+  ht->ht_inline = 0;
+#endif
 }
 
 #ifdef CONFIG_WITH_STRCACHE2
@@ -85,9 +230,50 @@ void hash_init_strcached (struct hash_table *ht, unsigned long size,
   hash_init (ht, size, 0, 0, 0);
   ht->ht_strcache = strcache;
   ht->ht_off_string = off_string;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_size >= HASH_CTRL_GROUP)
+    {
+      ht->ht_capacity = ht->ht_size - (ht->ht_size / 8); /* 87.5% loading factor */
+      hash_ctrl_alloc (ht);
+    }
+#endif
 }
 #endif /* CONFIG_WITH_STRCACHE2 */
 
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+/* Same as hash_init_strcached, except that the caller provides the
+   initial item vector VEC and control bytes CTRL, typically as part of
+   the structure owning the table.  This saves two heap blocks for the
+   many tables that never outgrow their initial size.  SIZE must be a
+   power of two no smaller than HASH_CTRL_GROUP, and CTRL must have room
+   for HASH_CTRL_SIZE (SIZE) bytes.  The table moves to the heap when it
+   needs rehashing.  */
+void
+hash_init_strcached_inline (struct hash_table *ht, unsigned long size,
+                            struct strcache2 *strcache, unsigned int off_string,
+                            void **vec, unsigned char *ctrl)
+{
+  assert (size >= HASH_CTRL_GROUP && (size & (size - 1)) == 0);
+  ht->ht_vec = vec;
+  memset (vec, 0, size * sizeof (void *));
+  ht->ht_size = size;
+  ht->ht_capacity = size - (size / 8); /* 87.5% loading factor */
+  ht->ht_fill = 0;
+  ht->ht_empty_slots = size;
+  ht->ht_collisions = 0;
+  ht->ht_lookups = 0;
+  ht->ht_rehashes = 0;
+  ht->ht_hash_1 = 0;
+  ht->ht_hash_2 = 0;
+  ht->ht_compare = 0;
+  ht->ht_strcache = strcache;
+  ht->ht_off_string = off_string;
+  ht->ht_ctrl = ctrl;
+  memset (ctrl, HASH_CTRL_EMPTY, HASH_CTRL_SIZE (size));
+  ht->ht_inline = 1;
+}
+#endif /* CONFIG_WITH_HASH_CTRL_BYTES */
+
 /* Load an array of items into `ht'.  */
 
 void
@@ -181,6 +367,10 @@ hash_find_slot_strcached (struct hash_table *ht, const void *key)
 
   MAKE_STATS (ht->ht_lookups++);
   MAKE_STATS_3 (make_stats_ht_lookups++);
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_ctrl)
+    return hash_ctrl_find_slot (ht, str1);
+#endif
 
   /* first iteration unrolled. */
 
@@ -279,6 +469,10 @@ hash_insert_at (struct hash_table *ht, const void *item, const void *slot)
       old_item = item;
     }
   *(void const **) slot = item;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_ctrl)
+    hash_ctrl_store (ht, item, (void **) slot);
+#endif
   if (ht->ht_empty_slots < ht->ht_size - ht->ht_capacity)
     {
       hash_rehash (ht);
@@ -315,6 +509,10 @@ hash_delete_at (struct hash_table *ht, const void *slot)
   if (!HASH_VACANT (item))
     {
       *(void const **) slot = hash_deleted_item;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+      if (ht->ht_ctrl)
+        hash_ctrl_set (ht, (void **) slot - ht->ht_vec, HASH_CTRL_DELETED);
+#endif
       ht->ht_fill--;
       return item;
     }
@@ -336,6 +534,10 @@ hash_free_items (struct hash_table *ht)
     }
   ht->ht_fill = 0;
   ht->ht_empty_slots = ht->ht_size;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_ctrl)
+    memset (ht->ht_ctrl, HASH_CTRL_EMPTY, HASH_CTRL_SIZE (ht->ht_size));
+#endif
 }
 
 #ifdef CONFIG_WITH_ALLOC_CACHES
@@ -353,6 +555,10 @@ hash_free_items_cached (struct hash_table *ht, struct alloccache *cache)
     }
   ht->ht_fill = 0;
   ht->ht_empty_slots = ht->ht_size;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_ctrl)
+    memset (ht->ht_ctrl, HASH_CTRL_EMPTY, HASH_CTRL_SIZE (ht->ht_size));
+#endif
 }
 #endif /* CONFIG_WITH_ALLOC_CACHES */
 
@@ -368,6 +574,10 @@ hash_delete_items (struct hash_table *ht)
   ht->ht_lookups = 0;
   ht->ht_rehashes = 0;
   ht->ht_empty_slots = ht->ht_size;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_ctrl)
+    memset (ht->ht_ctrl, HASH_CTRL_EMPTY, HASH_CTRL_SIZE (ht->ht_size));
+#endif
 }
 
 void
@@ -380,7 +590,17 @@ hash_free (struct hash_table *ht, int free_items)
       ht->ht_fill = 0;
       ht->ht_empty_slots = ht->ht_size;
     }
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (!ht->ht_inline)
+    {
+      free (ht->ht_vec);
+      free (ht->ht_ctrl);
+    }
+  ht->ht_ctrl = 0;
+  ht->ht_inline = 0;
+#else
   free (ht->ht_vec);
+#endif
   ht->ht_vec = 0;
   ht->ht_capacity = 0;
 }
@@ -396,7 +616,17 @@ hash_free_cached (struct hash_table *ht, int free_items, struct alloccache *cach
       ht->ht_fill = 0;
       ht->ht_empty_slots = ht->ht_size;
     }
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (!ht->ht_inline)
+    {
+      free (ht->ht_vec);
+      free (ht->ht_ctrl);
+    }
+  ht->ht_ctrl = 0;
+  ht->ht_inline = 0;
+#else
   free (ht->ht_vec);
+#endif
   ht->ht_vec = 0;
   ht->ht_capacity = 0;
 }
@@ -437,6 +667,10 @@ hash_rehash (struct hash_table *ht)
   void **old_vec = ht->ht_vec;
   void **ovp;
 
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  unsigned char *old_ctrl = ht->ht_ctrl;
+#endif
+
   if (ht->ht_fill >= ht->ht_capacity)
     {
       ht->ht_size *= 2;
@@ -444,6 +678,13 @@ hash_rehash (struct hash_table *ht)
     }
   ht->ht_rehashes++;
   ht->ht_vec = (void **) CALLOC (struct token *, ht->ht_size);
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (ht->ht_strcache && ht->ht_size >= HASH_CTRL_GROUP)
+    {
+      ht->ht_capacity = ht->ht_size - (ht->ht_size >> 3);
+      hash_ctrl_alloc (ht);
+    }
+#endif
 
 #ifndef CONFIG_WITH_STRCACHE2
   for (ovp = old_vec; ovp < &old_vec[old_ht_size]; ovp++)
@@ -462,6 +703,10 @@ hash_rehash (struct hash_table *ht)
           {
             void **slot = hash_find_slot_strcached (ht, *ovp);
             *slot = *ovp;
+# ifdef CONFIG_WITH_HASH_CTRL_BYTES
+            if (ht->ht_ctrl)
+              hash_ctrl_store (ht, *ovp, slot);
+# endif
           }
       }
   else
@@ -475,7 +720,16 @@ hash_rehash (struct hash_table *ht)
       }
 #endif /* CONFIG_WITH_STRCACHE2 */
   ht->ht_empty_slots = ht->ht_size - ht->ht_fill;
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  if (!ht->ht_inline)
+    {
+      free (old_vec);
+      free (old_ctrl);
+    }
+  ht->ht_inline = 0;
+#else
   free (old_vec);
+#endif
 }
 
 void
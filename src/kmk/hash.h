@@ -55,6 +55,10 @@ struct hash_table
   struct strcache2 *ht_strcache; /* the string cache pointer. */
   unsigned int ht_off_string;  /* offsetof (struct key, string) */
 #endif
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+  unsigned char *ht_ctrl;	/* one tag byte per slot for strcached tables */
+  int ht_inline;		/* ht_vec and ht_ctrl belong to the caller */
+#endif
 };
 
 typedef int (*qsort_cmp_t) __P((void const *, void const *));
@@ -89,6 +93,15 @@ void *hash_find_item_strcached __P((struct hash_table *ht, void const *key));
 void *hash_insert_strcached __P((struct hash_table *ht, const void *item));
 void *hash_delete_strcached __P((struct hash_table *ht, void const *item));
 #endif /* CONFIG_WITH_STRCACHE2 */
+#ifdef CONFIG_WITH_HASH_CTRL_BYTES
+/* Control bytes are probed in groups of this many.  */
+# define HASH_CTRL_GROUP	16
+/* The size of the control byte array for a table with SIZE slots.  */
+# define HASH_CTRL_SIZE(size)	((size) + HASH_CTRL_GROUP - 1)
+void hash_init_strcached_inline __P((struct hash_table *ht, unsigned long size,
+                                     struct strcache2 *strcache, unsigned int off_strptr,
+                                     void **vec, unsigned char *ctrl));
+#endif /* CONFIG_WITH_HASH_CTRL_BYTES */
 
 extern void *hash_deleted_item;
 #define HASH_VACANT(item) ((item) == 0 || (void *) (item) == hash_deleted_item)
@@ -190,6 +190,29 @@ stemlen_compare (const void *v1, const void *v2)
   return r != 0 ? r : (int)(r1->order - r2->order);
 }
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+/* Returns the next pattern rule in C that may match, merging the two lists
+   so the rules come in definition order.  The index of the target is put
+   in *TIP.  Returns NULL when there are no more candidates.  */
+
+MY_INLINE struct rule *
+next_pattern_rule_candidate (struct rule_candidates *c, unsigned int *tip)
+{
+  const struct rule_target_ref *ref;
+
+  if (c->cur < c->cur_end
+      && (c->any >= c->any_end || c->cur->seq < c->any->seq))
+    ref = c->cur++;
+  else if (c->any < c->any_end)
+    ref = c->any++;
+  else
+    return 0;
+
+  *tip = ref->ti;
+  return ref->rule;
+}
+#endif
+
 /* Search the pattern rules for a rule with an existing dependency to make
    FILE.  If a rule is found, the appropriate commands and deps are put in FILE
    and 1 is returned.  If not, 0 is returned.
@@ -223,9 +246,14 @@ pattern_search (struct file *file, int archive,
   struct file *int_file = 0;
 
   /* List of dependencies found recursively.  */
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
   struct patdeps *deplist
     = xmalloc (max_pattern_deps * sizeof (struct patdeps));
   struct patdeps *pat = deplist;
+#else
+  struct patdeps *deplist;
+  struct patdeps *pat;
+#endif
 
   /* All the prerequisites actually found for a rule, after expansion.  */
   struct dep *deps;
@@ -239,8 +267,16 @@ pattern_search (struct file *file, int archive,
   unsigned int fullstemlen = 0;
 
   /* Buffer in which we store all the rules that are possibly applicable.  */
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
   struct tryrule *tryrules = xmalloc (num_pattern_rules * max_pattern_targets
                                       * sizeof (struct tryrule));
+#else
+  struct tryrule *tryrules;
+
+  /* The pattern rule targets that may match FILENAME.  */
+  struct rule_candidates candidates;
+  unsigned int ti;
+#endif
 
   /* Number of valid elements in TRYRULES.  */
   unsigned int nrules;
@@ -301,13 +337,31 @@ pattern_search (struct file *file, int archive,
 
   pathlen = lastslash - filename + 1;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  /* Only pattern rule targets ending with the same character as FILENAME,
+     or with the `%', can possibly match it.  Quite often (header files
+     and such) there aren't any and we can skip all the work below.  */
+  nrules = pattern_rule_candidates (&candidates, filename, namelen);
+  if (nrules == 0)
+    return 0;
+  tryrules = xmalloc (nrules * sizeof (struct tryrule));
+  deplist = xmalloc (max_pattern_deps * sizeof (struct patdeps));
+  pat = deplist;
+#endif
+
   /* First see which pattern rules match this target and may be considered.
      Put them in TRYRULES.  */
 
   nrules = 0;
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
   for (rule = pattern_rules; rule != 0; rule = rule->next)
+#else
+  while ((rule = next_pattern_rule_candidate (&candidates, &ti)) != 0)
+#endif
     {
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
       unsigned int ti;
+#endif
 
       /* If the pattern rule has deps but no commands, ignore it.
          Users cancel built-in rules by redefining them without commands.  */
@@ -322,7 +376,9 @@ pattern_search (struct file *file, int archive,
           continue;
         }
 
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
       for (ti = 0; ti < rule->num; ++ti)
+#endif
         {
           const char *target = rule->targets[ti];
           const char *suffix = rule->suffixes[ti];
@@ -82,6 +82,10 @@
 # define PARSE_IN_WORKER
 #endif
 
+#if defined (PARSE_IN_WORKER) && !defined (CONFIG_WITHOUT_THREADS) && !defined (STRCACHE2_THREAD_SAFE)
+# error "The workers need a thread safe file string cache."
+#endif
+
 
 /*******************************************************************************
 *   Structures and Typedefs                                                    *
@@ -118,8 +122,8 @@ struct incdep_recorded_file
     struct incdep_recorded_file *next;
 
     /* the parameters */
-    struct strcache2_entry *filename_entry; /* dep strcache; converted to a nameseq record. */
-    struct dep *deps;                       /* All the names are dep strcache entries. */
+    const char *filename;                   /* file strcache. */
+    struct dep *deps;                       /* All the names are in the file strcache. */
     const struct floc *flocp;               /* NILF */
 };
 
@@ -207,7 +211,6 @@ static TID incdep_threads[INCDEP_MAX_THREADS];
 
 static struct alloccache incdep_rec_caches[INCDEP_MAX_THREADS];
 static struct alloccache incdep_dep_caches[INCDEP_MAX_THREADS];
-static struct strcache2 incdep_dep_strcaches[INCDEP_MAX_THREADS];
 static struct strcache2 incdep_var_strcaches[INCDEP_MAX_THREADS];
 static unsigned incdep_num_threads;
 
@@ -728,17 +731,6 @@ incdep_init (struct floc *f)
                            incdep_cache_allocator, (void *)(size_t)i);
           alloccache_init (&incdep_dep_caches[i], sizeof(struct dep), "incdep dep",
                            incdep_cache_allocator, (void *)(size_t)i);
-          strcache2_init (&incdep_dep_strcaches[i],
-                          "incdep dep", /* name */
-                          65536,        /* hash size */
-                          0,            /* default segment size*/
-#ifdef HAVE_CASE_INSENSITIVE_FS
-                          1,            /* case insensitive */
-#else
-                          0,            /* case insensitive */
-#endif
-                          0);           /* thread safe */
-
           strcache2_init (&incdep_var_strcaches[i],
                           "incdep var", /* name */
                           32768,        /* hash size */
@@ -813,7 +805,6 @@ incdep_flush_and_term (void)
       /* terminate or join up the allocation caches. */
       alloccache_term (&incdep_rec_caches[i], incdep_cache_deallocator, (void *)(size_t)i);
       alloccache_join (&dep_cache, &incdep_dep_caches[i]);
-      strcache2_term (&incdep_dep_strcaches[i]);
       strcache2_term (&incdep_var_strcaches[i]);
     }
   incdep_num_threads = 0;
@@ -899,12 +890,8 @@ incdep_flush_recorded_instructions (struct incdep *cur)
     do
       {
         void *free_me = rec_f;
-        struct dep *dep;
-
-        for (dep = rec_f->deps; dep; dep = dep->next)
-          dep->name = incdep_flush_strcache_entry ((struct strcache2_entry *)dep->name);
 
-        incdep_commit_recorded_file (incdep_flush_strcache_entry (rec_f->filename_entry),
+        incdep_commit_recorded_file (rec_f->filename,
                                      rec_f->deps,
                                      rec_f->flocp);
 
@@ -946,11 +933,9 @@ incdep_dep_strcache (struct incdep *cur, const char *str, int len)
       ((char *)str)[len] = ch;
     }
   else
-    {
-      /* Add it out the strcache of the thread. */
-      ret = strcache2_add (&incdep_dep_strcaches[cur->worker_tid], str, len);
-      ret = (const char *)strcache2_get_entry(&incdep_dep_strcaches[cur->worker_tid], ret);
-    }
+    /* The file string cache is thread safe, so add it straight to it
+       instead of going via a private cache and translating it later. */
+    ret = strcache2_add_file (&file_strcache, str, len);
   return ret;
 }
 
@@ -1127,7 +1112,7 @@ incdep_record_file (struct incdep *cur,
       struct incdep_recorded_file *rec =
         (struct incdep_recorded_file *) incdep_alloc_rec (cur);
 
-      rec->filename_entry = (struct strcache2_entry *)filename;
+      rec->filename = filename;
       rec->deps = deps;
       rec->flocp = flocp;
 
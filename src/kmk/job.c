@@ -227,6 +227,12 @@ static int start_waiting_job (struct child *);
 #ifdef CONFIG_WITH_PRINT_TIME_SWITCH
 static void print_job_time (struct child *);
 #endif
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+static int output_start (struct output *);
+static void output_hold (struct output *);
+static void output_dump (struct output *);
+static void output_close (struct output *);
+#endif
 
 /* Chain of all live (or recently deceased) children.  */
 
@@ -824,6 +830,12 @@ reap_children (int block, int err)
 
       dontcare = c->dontcare;
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+      /* What we have to say about the job goes with its output.  */
+      if (c->output.out)
+        output_start (&c->output);
+#endif
+
       if (child_failed && !c->noerror && !ignore_errors_flag)
         {
           /* The commands failed.  Write an error message,
@@ -880,6 +892,12 @@ reap_children (int block, int err)
                      Also, start_remote_job may need state set up
                      by start_remote_job_p.  */
                   c->remote = start_remote_job_p (0);
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+                  if (output_sync == OUTPUT_SYNC_LINE)
+                    output_dump (&c->output);
+                  else
+                    output_hold (&c->output);
+#endif
                   start_job_command (c);
                   /* Fatal signals are left blocked in case we were
                      about to put that child on the chain.  But it is
@@ -909,6 +927,10 @@ reap_children (int block, int err)
          ran; notice_finish_file looks for cs_running to tell it that
          it's interesting to check the file's modtime again now.  */
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+      output_end ();
+#endif
+
       if (! handling_fatal_signal)
         /* Notice if the target of the commands has been changed.
            This also propagates its values for command_state and
@@ -958,8 +980,15 @@ reap_children (int block, int err)
 static void
 free_child (struct child *child)
 {
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  if (child->output.out)
+    output_start (&child->output);
+#endif
 #ifdef CONFIG_WITH_PRINT_TIME_SWITCH
   print_job_time (child);
+#endif
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  output_close (&child->output);
 #endif
   if (!jobserver_tokens)
     fatal (NILF, "INTERNAL: Freeing child %p (%s) but no tokens left!\n",
@@ -1235,6 +1264,12 @@ start_job_command (struct child *child)
     next_command:
 #ifdef __MSDOS__
       execute_by_shell = 0;   /* in case construct_command_argv sets it */
+#endif
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+      if (output_sync == OUTPUT_SYNC_LINE)
+        output_dump (&child->output);
+      else
+        output_end ();
 #endif
       /* This line has no commands.  Go to the next.  */
       if (job_next_command (child))
@@ -1250,6 +1285,19 @@ start_job_command (struct child *child)
       return;
     }
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  /* Collect the output of this line.  A recursive make is left alone unless
+     syncing recursively, it syncs its own jobs; but flush what the target
+     said so far to keep things in order.  */
+  if (output_sync != OUTPUT_SYNC_NONE)
+    {
+      if (output_sync == OUTPUT_SYNC_RECURSE || !(flags & COMMANDS_RECURSE))
+        output_start (&child->output);
+      else
+        output_dump (&child->output);
+    }
+#endif
+
   /* Print out the command.  If silent, we call `message' with null so it
      can log the working directory before the command's own error messages
      appear.  */
@@ -1350,6 +1398,9 @@ start_job_command (struct child *child)
       if (!rc && child->pid)
         {
           ++job_counter;
+# ifdef CONFIG_WITH_OUTPUT_SYNC
+          output_end ();
+# endif
           return;
         }
 
@@ -1360,6 +1411,9 @@ start_job_command (struct child *child)
           child->status = rc << 8;
           child->has_status = 1;
           unblock_sigs();
+# ifdef CONFIG_WITH_OUTPUT_SYNC
+          output_end ();
+# endif
           return;
         }
 
@@ -1639,6 +1693,10 @@ start_job_command (struct child *child)
 #endif /* WINDOWS32 */
 #endif	/* __MSDOS__ or Amiga or WINDOWS32 */
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  output_end ();
+#endif
+
   /* Bump the number of jobs started in this second.  */
   ++job_counter;
 
@@ -1659,6 +1717,9 @@ start_job_command (struct child *child)
   return;
 
  error:
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  output_end ();
+#endif
   child->file->update_status = 2;
   notice_finished_file (child->file);
 #ifdef KMK /* fix leak */
@@ -3611,6 +3672,285 @@ void print_job_time (struct child *c)
 }
 #endif
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+
+/* Output synchronization (--output-sync).
+
+   While make works on behalf of a job -- echoing a command line, running a
+   builtin, starting a child or reporting an error -- file descriptors 1 and
+   2 point at temporary files belonging to the job.  Children inherit them,
+   so there is nothing to drain while they run.  When the job completes (or
+   after each line with --output-sync=line) the files are copied to the real
+   stdout and stderr while holding a lock on stdout, so sub-makes sharing it
+   don't interleave either.  The temporary files are then emptied and
+   recycled.
+
+   The files are opened for appending, since a child may have moved the
+   shared offset or reopened the file (e.g. >/dev/stdout) and truncated it.
+   As such a truncation would also eat the output of the earlier lines, that
+   is moved to files the children never see once each line completes.  */
+
+/* Duplicates of the real stdout and stderr, -1 until first needed.  */
+static int output_stdout = -1;
+static int output_stderr = -1;
+
+/* Nonzero if stdout and stderr are the same file, in which case a job gets
+   a single temporary file and the order of the two is kept.  */
+static int output_combined = -1;
+
+/* The job output fds 1 and 2 currently point to, if any.  */
+static struct output *output_current = 0;
+
+/* Emptied temporary files available for reuse.  */
+static FILE **output_pool = 0;
+static unsigned int output_pool_count = 0;
+static unsigned int output_pool_size = 0;
+
+/* Get an empty temporary file.  */
+
+static FILE *
+output_tmp (void)
+{
+  FILE *f;
+
+  if (output_pool_count > 0)
+    return output_pool[--output_pool_count];
+
+  f = tmpfile ();
+  if (f)
+    {
+      CLOSE_ON_EXEC (fileno (f));
+#ifdef O_APPEND
+      fcntl (fileno (f), F_SETFL, fcntl (fileno (f), F_GETFL) | O_APPEND);
+#endif
+    }
+  return f;
+}
+
+/* Get the size of the temporary file F, zero if NULL.  */
+
+static off_t
+output_size (FILE *f)
+{
+  struct stat st;
+
+  if (!f || fstat (fileno (f), &st) != 0)
+    return 0;
+  return st.st_size;
+}
+
+/* Put the empty temporary file F back in the pool.  */
+
+static void
+output_tmp_release (FILE *f)
+{
+  if (output_pool_count == output_pool_size)
+    {
+      output_pool_size = output_pool_size ? output_pool_size * 2 : 16;
+      output_pool = xrealloc (output_pool, output_pool_size * sizeof (FILE *));
+    }
+  output_pool[output_pool_count++] = f;
+}
+
+/* Point fds 1 and 2 at the temporary files of OUT, creating them as needed.
+   If that isn't possible, output synchronization is turned off and zero
+   returned.  */
+
+static int
+output_start (struct output *out)
+{
+  if (output_current == out)
+    return 1;
+  output_end ();
+
+  if (output_stdout < 0)
+    {
+      struct stat st1, st2;
+
+      output_stdout = dup (1);
+      output_stderr = dup (2);
+      if (output_stdout < 0 || output_stderr < 0)
+        {
+          perror_with_name ("dup", "");
+          output_sync = OUTPUT_SYNC_NONE;
+          return 0;
+        }
+      CLOSE_ON_EXEC (output_stdout);
+      CLOSE_ON_EXEC (output_stderr);
+
+      output_combined = fstat (1, &st1) == 0
+                     && fstat (2, &st2) == 0
+                     && st1.st_dev == st2.st_dev
+                     && st1.st_ino == st2.st_ino;
+    }
+
+  if (!out->out)
+    {
+      out->out = output_tmp ();
+      out->err = out->out && !output_combined ? output_tmp () : out->out;
+      if (!out->out || !out->err)
+        {
+          perror_with_name ("tmpfile", "");
+          output_close (out);
+          output_sync = OUTPUT_SYNC_NONE;
+          return 0;
+        }
+    }
+
+  fflush (stdout);
+  fflush (stderr);
+  dup2 (fileno (out->out), 1);
+  dup2 (fileno (out->err), 2);
+  output_current = out;
+  return 1;
+}
+
+/* Point fds 1 and 2 back at the real stdout and stderr.  */
+
+void
+output_end (void)
+{
+  if (output_current)
+    {
+      fflush (stdout);
+      fflush (stderr);
+      dup2 (output_stdout, 1);
+      dup2 (output_stderr, 2);
+      output_current = 0;
+    }
+}
+
+/* Lock (LOCK nonzero) or unlock stdout.  Failures are ignored, it only
+   matters when sub-makes share stdout.  */
+
+static void
+output_lock (int lock)
+{
+#ifdef F_SETLKW
+  struct flock fl;
+  int r;
+
+  memset (&fl, 0, sizeof (fl));
+  fl.l_type = lock ? F_WRLCK : F_UNLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 1;
+  EINTRLOOP (r, fcntl (output_stdout, F_SETLKW, &fl));
+#else
+  (void) lock;
+#endif
+}
+
+/* Copy the first SIZE bytes of F to FD and empty F.  */
+
+static void
+output_copy (FILE *f, off_t size, int fd)
+{
+  char buf[8192];
+  int src = fileno (f);
+  int len, r;
+  char *p;
+
+  lseek (src, 0, SEEK_SET);
+  while (size > 0)
+    {
+      EINTRLOOP (len, read (src, buf, size < (off_t) sizeof (buf)
+                                      ? (unsigned int) size : sizeof (buf)));
+      if (len <= 0)
+        break;
+      size -= len;
+      for (p = buf; len > 0; p += r, len -= r)
+        {
+          EINTRLOOP (r, write (fd, p, len));
+          if (r <= 0)
+            break;
+        }
+    }
+  lseek (src, 0, SEEK_SET);
+  ftruncate (src, 0);
+}
+
+/* Move what the last line of OUT wrote to its held files, where the next
+   lines cannot truncate it.  */
+
+static void
+output_hold (struct output *out)
+{
+  off_t outlen, errlen;
+
+  if (!out->out)
+    return;
+  output_end ();
+
+  outlen = output_size (out->out);
+  errlen = out->err != out->out ? output_size (out->err) : 0;
+  if (outlen > 0)
+    {
+      if (!out->held_out)
+        out->held_out = output_tmp ();
+      if (out->held_out)
+        output_copy (out->out, outlen, fileno (out->held_out));
+    }
+  if (errlen > 0)
+    {
+      if (!out->held_err)
+        out->held_err = output_tmp ();
+      if (out->held_err)
+        output_copy (out->err, errlen, fileno (out->held_err));
+    }
+}
+
+/* Write out what has been collected in OUT and empty it.  */
+
+static void
+output_dump (struct output *out)
+{
+  off_t heldoutlen, helderrlen, outlen, errlen;
+
+  if (!out->out)
+    return;
+  output_end ();
+
+  heldoutlen = output_size (out->held_out);
+  helderrlen = output_size (out->held_err);
+  outlen = output_size (out->out);
+  errlen = out->err != out->out ? output_size (out->err) : 0;
+  if (heldoutlen <= 0 && helderrlen <= 0 && outlen <= 0 && errlen <= 0)
+    return;
+
+  fflush (stdout);
+  fflush (stderr);
+  output_lock (1);
+  if (heldoutlen > 0)
+    output_copy (out->held_out, heldoutlen, 1);
+  if (outlen > 0)
+    output_copy (out->out, outlen, 1);
+  if (helderrlen > 0)
+    output_copy (out->held_err, helderrlen, 2);
+  if (errlen > 0)
+    output_copy (out->err, errlen, 2);
+  output_lock (0);
+}
+
+/* Write out what has been collected in OUT and release its files.  */
+
+static void
+output_close (struct output *out)
+{
+  output_dump (out);
+  if (out->held_err)
+    output_tmp_release (out->held_err);
+  if (out->held_out)
+    output_tmp_release (out->held_out);
+  if (out->err && out->err != out->out)
+    output_tmp_release (out->err);
+  if (out->out)
+    output_tmp_release (out->out);
+  out->out = out->err = out->held_out = out->held_err = 0;
+}
+
+#endif /* CONFIG_WITH_OUTPUT_SYNC */
+
 /* On VMS systems, include special VMS functions.  */
 
 #ifdef VMS
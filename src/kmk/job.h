@@ -38,6 +38,17 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 /* Structure describing a running or dead child process.  */
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+/* The temporary files collecting the output of a job (--output-sync).  */
+struct output
+  {
+    FILE *out;                  /* The job's stdout, NULL if not syncing.  */
+    FILE *err;                  /* The job's stderr, same as OUT if combined.  */
+    FILE *held_out;             /* Output of earlier lines, not shared.  */
+    FILE *held_err;             /* Likewise for stderr, NULL if combined.  */
+  };
+#endif
+
 struct child
   {
     struct child *next;		/* Link in the chain.  */
@@ -70,6 +81,9 @@ struct child
     unsigned int dontcare:1;    /* Saved dontcare flag.  */
 #ifdef CONFIG_WITH_PRINT_TIME_SWITCH
     big_int start_ts;           /* nano_timestamp of the first command.  */
+#endif
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+    struct output output;       /* Output collected for --output-sync.  */
 #endif
   };
 
@@ -113,4 +127,8 @@ extern int fatal_signal_mask;
 
 extern unsigned int jobserver_tokens;
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+void output_end (void);
+#endif
+
 #endif /* SEEN_JOB_H */
@@ -1389,6 +1389,315 @@ kbuild_put_sdks(struct kbuild_sdks *pSdks)
 }
 
 
+/* A variable value collected by kbuild_collect_source_prop. */
+struct kbuild_prop_var
+{
+    struct variable    *pVar;
+    unsigned int        cchExp;
+    char               *pszExp;
+};
+
+
+/* Joins the values collected by kbuild_collect_source_prop, freeing the
+   expanded ones.  PSZPREFIX is the already joined values going before them
+   (or after them when going right-to-left).  CCHTOTAL is the length of the
+   values plus a space for each. */
+static char *
+kbuild_join_source_prop_vars(struct kbuild_prop_var *paVars, int cVars, size_t cchTotal, int iDirection,
+                             const char *pszPrefix, size_t cchPrefix, size_t *pcchResult)
+{
+    char *pszResult, *psz;
+    int iVar;
+
+    psz = pszResult = xmalloc(cchPrefix + 1 + cchTotal + 1);
+    if (iDirection == 1 && cchPrefix)
+    {
+        my_memcpy(psz, pszPrefix, cchPrefix);
+        psz += cchPrefix;
+        *psz++ = ' ';
+    }
+    if (iDirection == 1)
+    {
+        for (iVar = 0; iVar < cVars; iVar++)
+        {
+            my_memcpy(psz, paVars[iVar].pszExp, paVars[iVar].cchExp);
+            psz += paVars[iVar].cchExp;
+            *psz++ = ' ';
+            if (paVars[iVar].pszExp != paVars[iVar].pVar->value)
+                free(paVars[iVar].pszExp);
+        }
+    }
+    else
+    {
+        iVar = cVars;
+        while (iVar-- > 0)
+        {
+            my_memcpy(psz, paVars[iVar].pszExp, paVars[iVar].cchExp);
+            psz += paVars[iVar].cchExp;
+            *psz++ = ' ';
+            if (paVars[iVar].pszExp != paVars[iVar].pVar->value)
+                free(paVars[iVar].pszExp);
+        }
+    }
+    if (iDirection != 1 && cchPrefix)
+    {
+        my_memcpy(psz, pszPrefix, cchPrefix);
+        psz += cchPrefix;
+        *psz++ = ' ';
+    }
+    assert(psz != pszResult);
+    assert(cchPrefix + (cchPrefix ? 1 : 0) + cchTotal == (size_t)(psz - pszResult));
+    psz[-1] = '\0';
+    *pcchResult = psz - pszResult - 1;
+    return pszResult;
+}
+
+
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+/*
+ * Cache for the source independent part of kbuild_collect_source_prop.
+ *
+ * The tool, SDK, global and target variables make up most of the lookups
+ * and they are the same for all the sources of a target, so the joined
+ * result is kept around for each property and reused as long as the target,
+ * tool, type, build type/target/arch/cpu, defpath and the global and target
+ * SDKs stay the same.  The variables are simple once looked up (see
+ * kbuild_lookup_variable_n), so the joined value changes only if one of them
+ * is assigned or appended to, which is checked for, or if a variable by one
+ * of the names we didn't find comes into existence.  All those names contain
+ * the property name, so variable.c tells us about new variables and we drop
+ * the entries whose property is part of the name (see
+ * kbuild_prop_cache_invalidate).  Only variables in the global set are
+ * cached, the others go away with their variable context.
+ */
+struct kbuild_prop_cache
+{
+    /** The property name, NULL if the entry is unused. */
+    char               *pszProp;
+    size_t              cchProp;
+    /** The direction the prefix was joined for. */
+    int                 iDirection;
+    /** The key, see kbuild_prop_cache_key. */
+    char               *pszKey;
+    size_t              cchKey;
+    /** The variable sets which were searched. */
+    unsigned            cSets;
+    struct variable_set *apSets[8];
+    /** The variables which went into the prefix and copies of their values. */
+    unsigned            cVars;
+    struct
+    {
+        struct variable    *pVar;
+        char               *pszValue;
+        unsigned int        cchValue;
+    }                  *paVars;
+    /** The joined prefix and its length. */
+    char               *pszPrefix;
+    size_t              cchPrefix;
+};
+
+/** One entry for each of DEFS, INCS, FLAGS, DEPS and ORDERDEPS, and a few
+ * for kb-src-prop users asking for other properties. */
+static struct kbuild_prop_cache g_aPropCache[8];
+static unsigned g_iPropCacheNext;
+/** Number of entries in use, for quickly ignoring new variables. */
+static unsigned g_cPropCacheUsed;
+
+
+/* Frees the cached data of an entry, making it unused. */
+static void
+kbuild_prop_cache_free(struct kbuild_prop_cache *pEntry)
+{
+    unsigned i;
+
+    if (pEntry->pszProp)
+        g_cPropCacheUsed--;
+    for (i = 0; i < pEntry->cVars; i++)
+        free(pEntry->paVars[i].pszValue);
+    free(pEntry->pszProp);
+    free(pEntry->pszKey);
+    free(pEntry->paVars);
+    free(pEntry->pszPrefix);
+    memset(pEntry, 0, sizeof(*pEntry));
+}
+
+
+/* Called by variable.c when a variable is defined for the first time in a
+   set or undefined.  Drops the entries which may have looked it up. */
+void
+kbuild_prop_cache_invalidate(const char *pszName, unsigned int cchName)
+{
+    unsigned i;
+
+    if (!g_cPropCacheUsed)
+        return;
+    for (i = 0; i < sizeof(g_aPropCache) / sizeof(g_aPropCache[0]); i++)
+    {
+        struct kbuild_prop_cache *pEntry = &g_aPropCache[i];
+        const char *psz, *pszLast;
+
+        if (!pEntry->pszProp || pEntry->cchProp > cchName)
+            continue;
+        pszLast = pszName + cchName - pEntry->cchProp;
+        for (psz = pszName; psz <= pszLast; psz++)
+            if (    *psz == *pEntry->pszProp
+                &&  !memcmp(psz, pEntry->pszProp, pEntry->cchProp))
+            {
+                kbuild_prop_cache_free(pEntry);
+                break;
+            }
+    }
+}
+
+
+/* Makes the key for the cache.  None of the values contain newlines. */
+static char *
+kbuild_prop_cache_key(struct variable *pTarget, struct variable *pTool, struct kbuild_sdks *pSdks,
+                      struct variable *pType, struct variable *pBldType, struct variable *pBldTrg,
+                      struct variable *pBldTrgArch, struct variable *pBldTrgCpu, struct variable *pDefPath,
+                      size_t *pcchKey)
+{
+    struct variable *apVars[8];
+    unsigned i, cVars = 0;
+    size_t cch = 0;
+    char *pszKey, *psz;
+
+    apVars[cVars++] = pTarget;
+    apVars[cVars++] = pTool;
+    apVars[cVars++] = pType;
+    apVars[cVars++] = pBldType;
+    apVars[cVars++] = pBldTrg;
+    apVars[cVars++] = pBldTrgArch;
+    apVars[cVars++] = pBldTrgCpu;
+    if (pDefPath)
+        apVars[cVars++] = pDefPath;
+    for (i = 0; i < cVars; i++)
+        cch += apVars[i]->value_length + 1;
+    for (i = pSdks->iGlobal; i < pSdks->iTarget + pSdks->cTarget; i++)
+        cch += pSdks->pa[i].value_length + 1;
+
+    psz = pszKey = xmalloc(cch + 2);
+    for (i = 0; i < cVars; i++)
+    {
+        my_memcpy(psz, apVars[i]->value, apVars[i]->value_length);
+        psz += apVars[i]->value_length;
+        *psz++ = '\n';
+    }
+    *psz++ = pDefPath ? '+' : '-';
+    for (i = pSdks->iGlobal; i < pSdks->iTarget + pSdks->cTarget; i++)
+    {
+        my_memcpy(psz, pSdks->pa[i].value, pSdks->pa[i].value_length);
+        psz += pSdks->pa[i].value_length;
+        *psz++ = i + 1 == pSdks->iTarget ? '|' : '\n';
+    }
+    *psz = '\0';
+    *pcchKey = psz - pszKey;
+    return pszKey;
+}
+
+
+/* Checks that the current variable set list is the one the entry was
+   made with. */
+static int
+kbuild_prop_cache_same_sets(struct kbuild_prop_cache *pEntry)
+{
+    struct variable_set_list *pList = current_variable_set_list;
+    unsigned i;
+
+    for (i = 0; i < pEntry->cSets; i++, pList = pList->next)
+        if (!pList || pList->set != pEntry->apSets[i])
+            return 0;
+    return pList == NULL;
+}
+
+
+/* Looks up the cache entry for the property, returning it with *pfHit set
+   if it can be used.  If it can't, the entry to replace is returned, and
+   the caller passes it and the key to kbuild_prop_cache_fill.  The key is
+   freed when not needed.  */
+static struct kbuild_prop_cache *
+kbuild_prop_cache_lookup(const char *pszProp, size_t cchProp, int iDirection, char *pszKey, size_t cchKey, int *pfHit)
+{
+    struct kbuild_prop_cache *pEntry;
+    unsigned i, j;
+
+    for (i = 0; i < sizeof(g_aPropCache) / sizeof(g_aPropCache[0]); i++)
+    {
+        pEntry = &g_aPropCache[i];
+        if (    pEntry->pszProp
+            &&  pEntry->cchProp == cchProp
+            &&  pEntry->iDirection == iDirection
+            &&  !memcmp(pEntry->pszProp, pszProp, cchProp))
+        {
+            *pfHit = pEntry->cchKey == cchKey
+                  && !memcmp(pEntry->pszKey, pszKey, cchKey)
+                  && kbuild_prop_cache_same_sets(pEntry);
+            for (j = 0; *pfHit && j < pEntry->cVars; j++)
+            {
+                struct variable *pVar = pEntry->paVars[j].pVar;
+                *pfHit = !pVar->recursive
+                      && pVar->value_length == pEntry->paVars[j].cchValue
+                      && !memcmp(pVar->value, pEntry->paVars[j].pszValue, pVar->value_length);
+            }
+            if (*pfHit)
+                free(pszKey);
+            return pEntry;
+        }
+    }
+
+    *pfHit = 0;
+    return &g_aPropCache[g_iPropCacheNext++ % (sizeof(g_aPropCache) / sizeof(g_aPropCache[0]))];
+}
+
+
+/* (Re)initializes a cache entry, taking ownership of the key. */
+static void
+kbuild_prop_cache_fill(struct kbuild_prop_cache *pEntry, const char *pszProp, size_t cchProp,
+                       int iDirection, char *pszKey, size_t cchKey, unsigned cVars)
+{
+    struct variable_set_list *pList;
+
+    kbuild_prop_cache_free(pEntry);
+    for (pList = current_variable_set_list; pList; pList = pList->next)
+    {
+        if (pEntry->cSets >= sizeof(pEntry->apSets) / sizeof(pEntry->apSets[0]))
+        {
+            free(pszKey);
+            return; /* too deep, don't cache. */
+        }
+        pEntry->apSets[pEntry->cSets++] = pList->set;
+    }
+    pEntry->pszProp     = xstrndup(pszProp, cchProp);
+    pEntry->cchProp     = cchProp;
+    pEntry->iDirection  = iDirection;
+    pEntry->pszKey      = pszKey;
+    pEntry->cchKey      = cchKey;
+    pEntry->paVars      = xmalloc((cVars ? cVars : 1) * sizeof(pEntry->paVars[0]));
+    g_cPropCacheUsed++;
+}
+
+
+/* Records a variable that went into the prefix of a cache entry being
+   filled.  Variables outside the global set makes the entry unusable. */
+static void
+kbuild_prop_cache_record(struct kbuild_prop_cache *pEntry, struct variable *pVar)
+{
+    if (!pEntry->pszProp)
+        return;
+    if (    pVar->origin == o_local
+        ||  lookup_variable_in_set(pVar->name, pVar->length, pEntry->apSets[pEntry->cSets - 1]) != pVar)
+    {
+        kbuild_prop_cache_free(pEntry);
+        return;
+    }
+    pEntry->paVars[pEntry->cVars].pVar     = pVar;
+    pEntry->paVars[pEntry->cVars].pszValue = xstrndup(pVar->value, pVar->value_length);
+    pEntry->paVars[pEntry->cVars].cchValue = pVar->value_length;
+    pEntry->cVars++;
+}
+#endif /* CONFIG_WITH_KBUILD_PROP_CACHE */
+
+
 /* this kind of stuff:
 
 defs        := $(kb-src-exp defs)
@@ -1528,12 +1837,17 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
     int cVars, iVar;
     size_t cchTotal, cchBuf;
     char *pszResult, *pszBuf, *psz, *psz2, *psz3;
-    struct
-    {
-        struct variable    *pVar;
-        unsigned int        cchExp;
-        char               *pszExp;
-    } *paVars;
+    const char *pszPrefix = NULL;
+    size_t cchPrefix = 0;
+    struct kbuild_prop_var *paVars;
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+    struct kbuild_prop_cache *pCache;
+    struct kbuild_prop_cache *pCacheFill = NULL;
+    char *pszPrefixCopy = NULL;
+    char *pszKey;
+    size_t cchKey;
+    int fHit;
+#endif
 
     assert(iDirection == 1 || iDirection == -1);
 
@@ -1567,11 +1881,17 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
 #define ADD_STR(pszStr, cchStr) do { my_memcpy(psz, (pszStr), (cchStr)); psz += (cchStr); } while (0)
 #define ADD_CSTR(pszStr)        do { my_memcpy(psz, pszStr, sizeof(pszStr) - 1); psz += sizeof(pszStr) - 1; } while (0)
 #define ADD_CH(ch)              do { *psz++ = (ch); } while (0)
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+# define PROP_CACHE_RECORD(pVar) do { if (pCacheFill) kbuild_prop_cache_record(pCacheFill, pVar); } while (0)
+#else
+# define PROP_CACHE_RECORD(pVar) do { } while (0)
+#endif
 #define DO_VAR_LOOKUP() \
     do { \
         pVar = kbuild_lookup_variable_n(pszBuf, psz - pszBuf); \
         if (pVar) \
         { \
+            PROP_CACHE_RECORD(pVar); \
             paVars[iVar].pVar = pVar; \
             if (    !pVar->recursive \
                 ||  !memchr(pVar->value, '$', pVar->value_length)) \
@@ -1642,6 +1962,22 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
        DO_SINGLE_PSZ3_VARIATION(); \
     } while (0)
 
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+    /* The tool, SDK, global and target part is usually cached. */
+    pszKey = kbuild_prop_cache_key(pTarget, pTool, pSdks, pType, pBldType, pBldTrg, pBldTrgArch, pBldTrgCpu,
+                                   pDefPath, &cchKey);
+    pCache = kbuild_prop_cache_lookup(pszProp, cchProp, iDirection, pszKey, cchKey, &fHit);
+    if (fHit)
+    {
+        pszPrefix = pCache->pszPrefix;
+        cchPrefix = pCache->cchPrefix;
+    }
+    else
+    {
+    pCacheFill = pCache;
+    kbuild_prop_cache_fill(pCacheFill, pszProp, cchProp, iDirection, pszKey, cchKey, cVars);
+#endif
+
     /* the tool (lowest priority). */
     psz = pszBuf;
     ADD_CSTR("TOOL_");
@@ -1689,6 +2025,29 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
     ADD_CH('_');
     DO_DOUBLE_PSZ2_VARIATION();
 
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+    /* Join what we've got so far and stash it in the cache. */
+    assert(iVar <= cVars);
+    if (cchTotal)
+        pCacheFill->pszPrefix = kbuild_join_source_prop_vars(paVars, iVar, cchTotal, iDirection, NULL, 0,
+                                                             &pCacheFill->cchPrefix);
+    pszPrefix = pCacheFill->pszPrefix;
+    cchPrefix = pCacheFill->cchPrefix;
+    pCacheFill = NULL;
+    iVar = 0;
+    cchTotal = 0;
+    }
+
+    /* Expanding the source part below may define a variable that drops the
+       cache entry along with the prefix, so use a copy of it. */
+    if (cchPrefix)
+    {
+        pszPrefixCopy = xmalloc(cchPrefix);
+        my_memcpy(pszPrefixCopy, pszPrefix, cchPrefix);
+        pszPrefix = pszPrefixCopy;
+    }
+#endif
+
     /* the source sdks. */
     iSdkEnd = iDirection == 1 ? pSdks->iSource + pSdks->cSource : pSdks->iSource - 1;
     for (iSdk = iDirection == 1 ? pSdks->iSource : pSdks->iSource + pSdks->cSource - 1;
@@ -1739,44 +2098,18 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
     /*
      * Construct the result value.
      */
-    if (!cVars || !cchTotal)
+    if (!cchPrefix && (!cVars || !cchTotal))
         pVar = define_variable_vl(pszVarName, cchVarName, "", 0,
                                   1 /* duplicate value */ , o_local, 0 /* !recursive */);
     else
     {
-        psz = pszResult = xmalloc(cchTotal + 1);
-        if (iDirection == 1)
-        {
-            for (iVar = 0; iVar < cVars; iVar++)
-            {
-                my_memcpy(psz, paVars[iVar].pszExp, paVars[iVar].cchExp);
-                psz += paVars[iVar].cchExp;
-                *psz++ = ' ';
-                if (paVars[iVar].pszExp != paVars[iVar].pVar->value)
-                    free(paVars[iVar].pszExp);
-            }
-        }
-        else
-        {
-            iVar = cVars;
-            while (iVar-- > 0)
-            {
-                my_memcpy(psz, paVars[iVar].pszExp, paVars[iVar].cchExp);
-                psz += paVars[iVar].cchExp;
-                *psz++ = ' ';
-                if (paVars[iVar].pszExp != paVars[iVar].pVar->value)
-                    free(paVars[iVar].pszExp);
-            }
-
-        }
-        assert(psz != pszResult);
-        assert(cchTotal == (size_t)(psz - pszResult));
-        psz[-1] = '\0';
-        cchTotal--;
-
+        pszResult = kbuild_join_source_prop_vars(paVars, cVars, cchTotal, iDirection, pszPrefix, cchPrefix, &cchTotal);
         pVar = define_variable_vl(pszVarName, cchVarName, pszResult, cchTotal,
                                   0 /* take pszResult */ , o_local, 0 /* !recursive */);
     }
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+    free(pszPrefixCopy);
+#endif
 
     return pVar;
 
@@ -1785,6 +2118,7 @@ kbuild_collect_source_prop(struct variable *pTarget, struct variable *pSource,
 #undef ADD_CSTR
 #undef ADD_CH
 #undef DO_VAR_LOOKUP
+#undef PROP_CACHE_RECORD
 #undef DO_DOUBLE_PSZ2_VARIATION
 #undef DO_SINGLE_PSZ3_VARIATION
 }
@@ -1941,6 +2275,450 @@ kbuild_set_object_name_and_dep_and_dirdep_and_PATH_target_source(struct variable
 }
 
 
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+
+/**
+ * Copies a string and returns a pointer to the end of the copy.
+ */
+MY_INLINE char *
+kbuild_src_rule_cpy(char *pszDst, const char *pchSrc, size_t cch)
+{
+    memcpy(pszDst, pchSrc, cch);
+    return pszDst + cch;
+}
+
+
+/**
+ * Checks that a value can be inserted as-is where eval would have expanded
+ * and parsed it as part of a rule line.
+ *
+ * @returns 1 if it can, 0 if it contains anything eval would treat specially.
+ * @param   pVar        The variable.
+ */
+static int
+kbuild_src_rule_is_plain(struct variable *pVar)
+{
+    const char *pchStart = pVar->value;
+    const char *pch      = pchStart;
+    const char *pchEnd   = pchStart + pVar->value_length;
+    while (pch < pchEnd)
+    {
+        switch (*pch++)
+        {
+            case '$':
+            case '\n':
+            case '#':
+            case ';':
+            case '=':
+                return 0;
+            case ':':
+#ifdef HAVE_DOS_PATHS
+                /* Drive letters are skipped by eval as well. */
+                if (   pch - 2 >= pchStart
+                    && isalpha((unsigned char)pch[-2])
+                    && (pch - 2 == pchStart || isblank((unsigned char)pch[-3]))
+                    && pch < pchEnd
+                    && (*pch == '/' || *pch == '\\'))
+                    break;
+#endif
+                return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Checks if the variable is defined and non-empty, i.e. what ifdef tests.
+ */
+static int
+kbuild_src_rule_ifdef(const char *pszName, size_t cchName)
+{
+    struct variable *pVar = lookup_variable(pszName, cchName);
+    return pVar != NULL && *pVar->value != '\0';
+}
+
+
+/**
+ * Checks if KMK_FEATURES has the given feature, what if1of tests.
+ */
+static int
+kbuild_src_rule_has_feature(const char *pszFeature, size_t cchFeature)
+{
+    struct variable *pVar = lookup_variable(ST("KMK_FEATURES"));
+    const char *psz, *pszEnd;
+    if (!pVar)
+        return 0;
+    psz = pVar->value;
+    pszEnd = psz + pVar->value_length;
+    while (psz < pszEnd)
+    {
+        const char *pszWord;
+        while (psz < pszEnd && isspace((unsigned char)*psz))
+            psz++;
+        pszWord = psz;
+        while (psz < pszEnd && !isspace((unsigned char)*psz))
+            psz++;
+        if (    (size_t)(psz - pszWord) == cchFeature
+            &&  !memcmp(pszWord, pszFeature, cchFeature))
+            return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Checks that def_target_source_rule is the one from the footer and not
+ * something the user has overridden, which we cannot know what does.
+ */
+static int
+kbuild_src_rule_is_footers(void)
+{
+    static const char s_szFooter[] = "footer-pass2-compiling-targets.kmk";
+    struct variable *pVar = lookup_variable(ST("def_target_source_rule"));
+    size_t cch;
+    if (!pVar || pVar->origin != o_file || !pVar->fileinfo.filenm)
+        return 0;
+    cch = strlen(pVar->fileinfo.filenm);
+    return cch >= sizeof(s_szFooter) - 1
+        && !strcmp(pVar->fileinfo.filenm + cch - sizeof(s_szFooter) + 1, s_szFooter);
+}
+
+
+/**
+ * Converts the recipe text of a tool into what eval collects as the commands
+ * of a rule: recipe prefix stripped and each line newline terminated.
+ *
+ * @returns Pointer to the end of the output, NULL if the text contains
+ *          anything but recipe lines, blank lines and comments.
+ * @param   pszDst      The output buffer, at least cch + 1 bytes big.
+ * @param   pch         The recipe text.
+ * @param   cch         The length of the recipe text.
+ */
+static char *
+kbuild_src_rule_recipe(char *pszDst, const char *pch, size_t cch)
+{
+    const char *pchEnd = pch + cch;
+    while (pch < pchEnd)
+    {
+        /* Find the end of the logical line like readstring does. */
+        const char *pchEol = pch;
+        for (;;)
+        {
+            const char *pchBol = pchEol;
+            const char *pchBs;
+            int fBackslash = 0;
+
+            pchEol = memchr(pchBol, '\n', pchEnd - pchBol);
+            if (!pchEol)
+            {
+                pchEol = pchEnd;
+                break;
+            }
+            pchBs = pchEol;
+            while (pchBs > pchBol && *--pchBs == '\\')
+                fBackslash = !fBackslash;
+            if (!fBackslash)
+                break;
+            pchEol++;
+        }
+
+        if (*pch == cmd_prefix)
+        {
+            const char *pchSrc = pch + 1;
+            while (pchSrc < pchEol)
+            {
+                *pszDst++ = *pchSrc;
+                if (pchSrc[0] == '\n' && pchSrc + 1 < pchEol && pchSrc[1] == cmd_prefix)
+                    pchSrc++;
+                pchSrc++;
+            }
+            *pszDst++ = '\n';
+        }
+        else
+        {
+            /* Blank lines and comments don't end the rule, anything else does. */
+            const char *pchSrc = pch;
+            while (pchSrc < pchEol && isspace((unsigned char)*pchSrc))
+                pchSrc++;
+            if (pchSrc < pchEol && *pchSrc != '#')
+                return NULL;
+        }
+        pch = pchEol + 1;
+    }
+    return pszDst;
+}
+
+
+/**
+ * Strips leading and trailing blanks off an xmalloc'ed string, returning
+ * NULL if nothing is left.  This is what eval does to a prerequisite list.
+ */
+static char *
+kbuild_src_rule_strip(char *psz, size_t cch)
+{
+    size_t off = 0;
+    while (off < cch && isspace((unsigned char)psz[off]))
+        off++;
+    while (cch > off && isspace((unsigned char)psz[cch - 1]))
+        cch--;
+    if (off >= cch)
+    {
+        free(psz);
+        return NULL;
+    }
+    if (off)
+        memmove(psz, psz + off, cch - off);
+    psz[cch - off] = '\0';
+    return psz;
+}
+
+
+/**
+ * Creates the rules def_target_source_rule would, without producing any
+ * makefile text for eval to parse.
+ *
+ * Sources using kObjCache or DONT_PURGE_OUTPUT tools, and values eval would
+ * expand or parse differently a second time, are left to the template.  So
+ * is everything when the template has been overridden, and the commands
+ * dependency file when KMK_FEATURES lacks append-define-cmds.
+ *
+ * @returns 0 on success, -1 if def_target_source_rule must be eval'ed.
+ */
+static int
+kbuild_source_one_rules(struct variable *pTarget, struct variable *pSource, struct variable *pTool,
+                        struct variable *pType, struct variable *pBldType, struct variable *pBldTrg,
+                        struct variable *pBldTrgArch, struct variable *pBldTrgCpu, struct variable *pObj,
+                        struct variable *pDep, struct variable *pCmds, struct variable *pOutput,
+                        struct variable *pOutputMaybe, struct variable *pDepend, struct variable *pDepOrd)
+{
+    static const char s_szSuffixes[][16] = { "_CMDS_", "_OUTPUT_", "_OUTPUT_MAYBE_", "_DEPEND_", "_DEPORD_" };
+    struct variable *pVar;
+    size_t cch, cchCmds, cchCmdsPrev, cchBase;
+    char *pszCmds, *pszCmdsPrev, *pszTargets, *pszDeps, *pszBase, *psz;
+    const char *pszObjBase, *pszObjExt;
+    unsigned iIntermediate, i;
+    int fCmdsDeps;
+
+    /*
+     * Things we don't deal with.
+     */
+    if (   !kbuild_src_rule_is_plain(pTarget)
+        || !kbuild_src_rule_is_plain(pSource)
+        || !kbuild_src_rule_is_plain(pTool)
+        || !kbuild_src_rule_is_plain(pType)
+        || !kbuild_src_rule_is_plain(pBldType)
+        || !kbuild_src_rule_is_plain(pBldTrg)
+        || !kbuild_src_rule_is_plain(pBldTrgArch)
+        || !kbuild_src_rule_is_plain(pBldTrgCpu)
+        || !kbuild_src_rule_is_plain(pObj)
+        || !kbuild_src_rule_is_plain(pDep)
+        || !kbuild_src_rule_is_plain(pOutput)
+        || !kbuild_src_rule_is_plain(pOutputMaybe)
+        || !kbuild_src_rule_is_plain(pDepend)
+        || !kbuild_src_rule_is_plain(pDepOrd)
+        || memchr(pObj->value, ' ', pObj->value_length)
+        || memchr(pObj->value, '\t', pObj->value_length)
+        || !pObj->value_length
+        || default_goal_var->value[0] == '\0'
+        || !kbuild_src_rule_is_footers())
+        return -1;
+
+    pVar = lookup_variable(ST("_DEP_COMPILE_CMDS"));
+    if (pVar && pVar->value_length)
+        return -1;
+
+    cch = sizeof("TOOL_") + pTool->value_length + sizeof("_COMPILE_") + pType->value_length + sizeof("_DONT_PURGE_OUTPUT");
+    psz = pszBase = alloca(cch);
+    psz = kbuild_src_rule_cpy(psz, ST("TOOL_"));
+    psz = kbuild_src_rule_cpy(psz, pTool->value, pTool->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST("_COMPILE_"));
+    psz = kbuild_src_rule_cpy(psz, pType->value, pType->value_length);
+    memcpy(psz, "_USES_KOBJCACHE", sizeof("_USES_KOBJCACHE"));
+    if (kbuild_src_rule_ifdef(pszBase, psz - pszBase + sizeof("_USES_KOBJCACHE") - 1))
+        return -1;
+    memcpy(psz, "_DONT_PURGE_OUTPUT", sizeof("_DONT_PURGE_OUTPUT"));
+    if (kbuild_src_rule_ifdef(pszBase, psz - pszBase + sizeof("_DONT_PURGE_OUTPUT") - 1))
+        return -1;
+
+    pVar = lookup_variable(ST("NO_COMPILE_CMDS_DEPS"));
+    fCmdsDeps = !pVar || *pVar->value == '\0';
+    if (fCmdsDeps && !kbuild_src_rule_has_feature(ST("append-define-cmds")))
+        return -1;
+
+    /* $(target)_$(subst :,_,$(source))_CMDS_PREV_ */
+    cchCmdsPrev = pTarget->value_length + 1 + pSource->value_length + sizeof("_CMDS_PREV_") - 1;
+    psz = pszCmdsPrev = alloca(cchCmdsPrev + 1);
+    psz = kbuild_src_rule_cpy(psz, pTarget->value, pTarget->value_length);
+    *psz++ = '_';
+    for (cch = 0; cch < pSource->value_length; cch++)
+        *psz++ = pSource->value[cch] != ':' ? pSource->value[cch] : '_';
+    memcpy(psz, "_CMDS_PREV_", sizeof("_CMDS_PREV_"));
+
+    /*
+     * The recipe.
+     *      %$(call MSG_COMPILE,$(target),$(source),$@,$(type))
+     *      $($(target)_$(source)_CMDS_)
+     *      %$(QUIET2)$(APPEND) -bdc '$(dep)' '$(target)_$(subst :,_,$(source))_CMDS_PREV_' '$(obj)'
+     */
+    cch = sizeof("%$(call MSG_COMPILE,,,$@,)\n") + pTarget->value_length + pSource->value_length + pType->value_length
+        + pCmds->value_length + 1
+        + sizeof("%$(QUIET2)$(APPEND) -bdc '' '' ''\n") + pDep->value_length + cchCmdsPrev + pObj->value_length;
+    psz = pszCmds = xmalloc(cch);
+    psz = kbuild_src_rule_cpy(psz, ST("%$(call MSG_COMPILE,"));
+    psz = kbuild_src_rule_cpy(psz, pTarget->value, pTarget->value_length);
+    *psz++ = ',';
+    psz = kbuild_src_rule_cpy(psz, pSource->value, pSource->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST(",$@,"));
+    psz = kbuild_src_rule_cpy(psz, pType->value, pType->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST(")\n"));
+    psz = kbuild_src_rule_recipe(psz, pCmds->value, pCmds->value_length);
+    if (!psz)
+    {
+        free(pszCmds);
+        return -1;
+    }
+    if (fCmdsDeps)
+    {
+        psz = kbuild_src_rule_cpy(psz, ST("%$(QUIET2)$(APPEND) -bdc '"));
+        psz = kbuild_src_rule_cpy(psz, pDep->value, pDep->value_length);
+        psz = kbuild_src_rule_cpy(psz, ST("' '"));
+        psz = kbuild_src_rule_cpy(psz, pszCmdsPrev, cchCmdsPrev);
+        psz = kbuild_src_rule_cpy(psz, ST("' '"));
+        psz = kbuild_src_rule_cpy(psz, pObj->value, pObj->value_length);
+        psz = kbuild_src_rule_cpy(psz, ST("'\n"));
+    }
+    cchCmds = psz - pszCmds;
+    assert(cchCmds < cch);
+
+    /*
+     * $(obj): .MUST_MAKE = $(comp-cmds-ex $($(target)_$(subst :,_,$(source))_CMDS_PREV_),$(commands $@),FORCE)
+     */
+    if (fCmdsDeps)
+    {
+        char *pszDefn;
+
+        cch = sizeof(".MUST_MAKE = $(comp-cmds-ex $(),$(commands $@),FORCE)") + cchCmdsPrev;
+        psz = pszDefn = alloca(cch);
+        psz = kbuild_src_rule_cpy(psz, ST(".MUST_MAKE = $(comp-cmds-ex $("));
+        psz = kbuild_src_rule_cpy(psz, pszCmdsPrev, cchCmdsPrev);
+        memcpy(psz, "),$(commands $@),FORCE)", sizeof("),$(commands $@),FORCE)"));
+
+        psz = pszTargets = alloca(pObj->value_length + 1);
+        memcpy(psz, pObj->value, pObj->value_length + 1);
+        eval_kbuild_target_var(pszTargets, pszDefn);
+    }
+
+    /*
+     * $(obj) + $(output) +| $(output_maybe) : $(depend) | $(depord) $$($(target)_INTERMEDIATES) ...
+     */
+    cch = pObj->value_length + sizeof(" + ") + pOutput->value_length + sizeof(" +| ") + pOutputMaybe->value_length;
+    psz = pszTargets = alloca(cch);
+    psz = kbuild_src_rule_cpy(psz, pObj->value, pObj->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST(" + "));
+    psz = kbuild_src_rule_cpy(psz, pOutput->value, pOutput->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST(" +| "));
+    psz = kbuild_src_rule_cpy(psz, pOutputMaybe->value, pOutputMaybe->value_length);
+    *psz = '\0';
+
+    cch = pDepend->value_length + sizeof("  | ") + pDepOrd->value_length
+        + 6 * (sizeof(" $(_INTERMEDIATES.)") + pTarget->value_length)
+        + pBldTrg->value_length * 2 + pBldTrgArch->value_length * 2 + pBldTrgCpu->value_length + pBldType->value_length;
+    psz = pszDeps = xmalloc(cch);
+    psz = kbuild_src_rule_cpy(psz, pDepend->value, pDepend->value_length);
+    psz = kbuild_src_rule_cpy(psz, ST("  | ")); /* same spacing as eval */
+    psz = kbuild_src_rule_cpy(psz, pDepOrd->value, pDepOrd->value_length);
+    for (iIntermediate = 0; iIntermediate < 6; iIntermediate++)
+    {
+        psz = kbuild_src_rule_cpy(psz, ST(" $("));
+        psz = kbuild_src_rule_cpy(psz, pTarget->value, pTarget->value_length);
+        psz = kbuild_src_rule_cpy(psz, ST("_INTERMEDIATES"));
+        switch (iIntermediate)
+        {
+            case 0:
+                break;
+            case 1:
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldTrg->value, pBldTrg->value_length);
+                break;
+            case 2:
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldTrg->value, pBldTrg->value_length);
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldTrgArch->value, pBldTrgArch->value_length);
+                break;
+            case 3:
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldTrgArch->value, pBldTrgArch->value_length);
+                break;
+            case 4:
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldTrgCpu->value, pBldTrgCpu->value_length);
+                break;
+            case 5:
+                *psz++ = '.';
+                psz = kbuild_src_rule_cpy(psz, pBldType->value, pBldType->value_length);
+                break;
+        }
+        *psz++ = ')';
+    }
+    assert((size_t)(psz - pszDeps) < cch);
+    pszDeps = kbuild_src_rule_strip(pszDeps, psz - pszDeps);
+
+    eval_kbuild_rule(pszTargets, pszDeps, pszCmds, cchCmds);
+    free(pszCmds);
+
+    /*
+     * $(basename $(notdir $(obj))).o: $(obj)
+     * $(basename $(notdir $(obj))).obj: $(obj)
+     */
+    pszObjBase = pObj->value + pObj->value_length;
+    while (   pszObjBase > pObj->value
+           && pszObjBase[-1] != '/'
+#ifdef HAVE_DOS_PATHS
+           && pszObjBase[-1] != '\\'
+           && pszObjBase[-1] != ':'
+#endif
+           )
+        pszObjBase--;
+    pszObjExt = pObj->value + pObj->value_length;
+    while (pszObjExt > pszObjBase && pszObjExt[-1] != '.')
+        pszObjExt--;
+    if (pszObjExt > pszObjBase)
+        pszObjExt--;
+    else
+        pszObjExt = pObj->value + pObj->value_length;
+    cchBase = pszObjExt - pszObjBase;
+
+    psz = pszTargets = alloca(cchBase + sizeof(".obj"));
+    memcpy(psz, pszObjBase, cchBase);
+    memcpy(psz + cchBase, ".o", sizeof(".o"));
+    eval_kbuild_rule(pszTargets, xstrndup(pObj->value, pObj->value_length), NULL, 0);
+    memcpy(psz, pszObjBase, cchBase);
+    memcpy(psz + cchBase, ".obj", sizeof(".obj"));
+    eval_kbuild_rule(pszTargets, xstrndup(pObj->value, pObj->value_length), NULL, 0);
+
+    /*
+     * $(target)_$(source)_CMDS_ := (and the other four)
+     */
+    cch = pTarget->value_length + 1 + pSource->value_length + sizeof("_OUTPUT_MAYBE_");
+    psz = pszBase = alloca(cch);
+    psz = kbuild_src_rule_cpy(psz, pTarget->value, pTarget->value_length);
+    *psz++ = '_';
+    psz = kbuild_src_rule_cpy(psz, pSource->value, pSource->value_length);
+    for (i = 0; i < sizeof(s_szSuffixes) / sizeof(s_szSuffixes[0]); i++)
+    {
+        strcpy(psz, s_szSuffixes[i]);
+        do_variable_definition_2(reading_file, pszBase, "", 0, 1 /* simple_value */, NULL,
+                                 o_file, f_simple, 0 /* !target_var */);
+    }
+
+    return 0;
+}
+
+#endif /* CONFIG_WITH_KBUILD_DIRECT_RULES */
+
+
 /* setup the base variables for def_target_source_c_cpp_asm_new:
 
 X := $(kb-src-tool tool)
@@ -1973,6 +2751,9 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
     struct variable *pOutBase   = kbuild_get_object_base(pTarget, pSource, "outbase");
     struct variable *pObjSuff   = kbuild_get_object_suffix(pTarget, pSource, pTool, pType, pBldTrg, pBldTrgArch, "objsuff");
     struct variable *pDefs, *pIncs, *pFlags, *pDeps, *pOrderDeps, *pDirDep, *pDep, *pVar, *pOutput, *pOutputMaybe;
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+    struct variable *pCmds, *pDepend, *pDepOrd;
+#endif
     struct variable *pObj       = kbuild_set_object_name_and_dep_and_dirdep_and_PATH_target_source(pTarget, pSource, pOutBase, pObjSuff, "obj", &pDep, &pDirDep);
     int fInstallOldVars = 0;
     char *pszDstVar, *pszDst, *pszSrcVar, *pszSrc, *pszVal, *psz;
@@ -1990,6 +2771,12 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
      * includedep queue feature. This means the files will be read by one or
      * more background threads, leaving the eval'ing to be done later on by
      * the main thread (in snap_deps).
+     *
+     * Version 3 is version 2 where the object rules are created directly
+     * instead of eval'ing def_target_source_rule, except for the cases
+     * kbuild_source_one_rules doesn't handle. It requires
+     * CONFIG_WITH_KBUILD_DIRECT_RULES and is advertised as kb-src-one-3 in
+     * KMK_FEATURES, so footer.kmk only uses it when it's here.
      */
     if (!argv[0][0])
         iVer = 0;
@@ -2108,6 +2895,9 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
     memcpy(pszSrc, "_CMDS", sizeof("_CMDS"));
     memcpy(pszDst, "_CMDS_", sizeof("_CMDS_"));
     pVar = kbuild_get_recursive_variable(pszSrcVar);
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+    pCmds =
+#endif
     do_variable_definition_2(NILF, pszDstVar, pVar->value, pVar->value_length,
                              !pVar->recursive, 0, o_local, f_simple, 0 /* !target_var */);
     do_variable_definition_2(NILF, "kbsrc_cmds", pVar->value, pVar->value_length,
@@ -2149,6 +2939,9 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
     do_variable_definition_2(NILF, pszDstVar, pszVal, pVar->value_length + 1 + pDeps->value_length + 1 + pSource->value_length,
                              !pVar->recursive && !pDeps->recursive && !pSource->recursive,
                              NULL, o_local, f_simple, 0 /* !target_var */);
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+    pDepend =
+#endif
     do_variable_definition_2(NILF, "kbsrc_depend", pszVal, pVar->value_length + 1 + pDeps->value_length + 1 + pSource->value_length,
                              !pVar->recursive && !pDeps->recursive && !pSource->recursive,
                              pszVal, o_local, f_simple, 0 /* !target_var */);
@@ -2166,6 +2959,9 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
                              pVar->value_length + 1 + pDirDep->value_length + 1 + pOrderDeps->value_length,
                              !pVar->recursive && !pDirDep->recursive && !pOrderDeps->recursive,
                              NULL, o_local, f_simple, 0 /* !target_var */);
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+    pDepOrd =
+#endif
     do_variable_definition_2(NILF, "kbsrc_depord", pszVal,
                              pVar->value_length + 1 + pDirDep->value_length + 1 + pOrderDeps->value_length,
                              !pVar->recursive && !pDirDep->recursive && !pOrderDeps->recursive,
@@ -2184,7 +2980,7 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
     */
     memcpy(pszDstVar + pTarget->value_length, "_2_OBJS", sizeof("_2_OBJS"));
     pVar = kbuild_query_recursive_variable_n(pszDstVar, pTarget->value_length + sizeof("_2_OBJS") - 1);
-    fInstallOldVars |= iVer <= 2 && (!pVar || !pVar->value_length);
+    fInstallOldVars |= iVer <= 3 && (!pVar || !pVar->value_length);
     if (pVar)
     {
         if (pVar->recursive)
@@ -2224,13 +3020,22 @@ func_kbuild_source_one(char *o, char **argv, const char *pszFuncName)
     /*
     $(eval $(def_target_source_rule))
     */
-    pVar = kbuild_get_recursive_variable("def_target_source_rule");
-    pszVal = variable_expand_string_2 (o, pVar->value, pVar->value_length, &psz);
-    assert(!((size_t)pszVal & 3));
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+    if (   iVer >= 3
+        && kbuild_source_one_rules(pTarget, pSource, pTool, pType, pBldType, pBldTrg, pBldTrgArch, pBldTrgCpu,
+                                   pObj, pDep, pCmds, pOutput, pOutputMaybe, pDepend, pDepOrd) == 0)
+        pszVal = variable_buffer_output (o, "", 1) - 1;
+    else
+#endif
+    {
+        pVar = kbuild_get_recursive_variable("def_target_source_rule");
+        pszVal = variable_expand_string_2 (o, pVar->value, pVar->value_length, &psz);
+        assert(!((size_t)pszVal & 3));
 
-    install_variable_buffer(&pszSavedVarBuf, &cchSavedVarBuf);
-    eval_buffer(pszVal, psz);
-    restore_variable_buffer(pszSavedVarBuf, cchSavedVarBuf);
+        install_variable_buffer(&pszSavedVarBuf, &cchSavedVarBuf);
+        eval_buffer(pszVal, psz);
+        restore_variable_buffer(pszSavedVarBuf, cchSavedVarBuf);
+    }
 
     kbuild_put_sdks(&Sdks);
     (void)pszFuncName;
@@ -2801,5 +3606,381 @@ func_kbuild_expand_template(char *o, char **argv, const char *pszFuncName)
     return o;
 }
 
+
+/* A string buffer for func_kbuild_collect_tools. */
+struct kbuild_tsu_buf
+{
+    char               *psz;
+    size_t              cch;
+    size_t              cchAlloc;
+};
+
+
+/* Appends a space separated string to a kbuild_tsu_buf. */
+static void
+kbuild_tsu_buf_add(struct kbuild_tsu_buf *pBuf, const char *pch, size_t cch)
+{
+    if (pBuf->cch + 1 + cch + 1 > pBuf->cchAlloc)
+    {
+        pBuf->cchAlloc = (pBuf->cch + 1 + cch + 1 + 255) & ~(size_t)255;
+        pBuf->cchAlloc *= 2;
+        pBuf->psz = xrealloc(pBuf->psz, pBuf->cchAlloc);
+    }
+    if (pBuf->cch)
+        pBuf->psz[pBuf->cch++] = ' ';
+    memcpy(pBuf->psz + pBuf->cch, pch, cch);
+    pBuf->cch += cch;
+    pBuf->psz[pBuf->cch] = '\0';
+}
+
+
+/* Looks up the variable named by the concatenation of the three strings and
+   returns its expanded value, NULL if it doesn't exist or is empty.  The
+   value is malloc'ed if it differs from the variable value (*ppszFree). */
+static const char *
+kbuild_tsu_lookup(const char *pch1, size_t cch1, const char *pch2, size_t cch2, const char *pch3, size_t cch3,
+                  unsigned int *pcchValue, char **ppszFree)
+{
+    struct variable *pVar;
+    size_t cchName = cch1 + cch2 + cch3;
+    char *pszName = alloca(cchName + 1);
+
+    memcpy(pszName, pch1, cch1);
+    memcpy(pszName + cch1, pch2, cch2);
+    memcpy(pszName + cch1 + cch2, pch3, cch3);
+    pszName[cchName] = '\0';
+
+    *ppszFree = NULL;
+    pVar = lookup_variable(pszName, cchName);
+    if (!pVar || !pVar->value_length)
+        return NULL;
+    if (    pVar->recursive
+        &&  (pVar->append || memchr(pVar->value, '$', pVar->value_length)))
+        return *ppszFree = recursively_expand_for_file(pVar, NULL, pcchValue);
+    *pcchValue = pVar->value_length;
+    return pVar->value;
+}
+
+
+/* Adds the expanded value of the variable named by the concatenation of the
+   three strings to the buffer. */
+static void
+kbuild_tsu_add_var(struct kbuild_tsu_buf *pBuf, const char *pch1, size_t cch1, const char *pch2, size_t cch2,
+                   const char *pch3, size_t cch3)
+{
+    unsigned int cchValue;
+    char *pszFree;
+    const char *pszValue = kbuild_tsu_lookup(pch1, cch1, pch2, cch2, pch3, cch3, &cchValue, &pszFree);
+    if (pszValue && cchValue)
+        kbuild_tsu_buf_add(pBuf, pszValue, cchValue);
+    free(pszFree);
+}
+
+
+/* Sets a local variable to the first word of the value of the variable
+   named by the concatenation of the two strings, or to the fallback value
+   if that's empty or not defined.  Returns the variable. */
+static struct variable *
+kbuild_tsu_first_word(const char *pszVarName, const char *pch1, size_t cch1, const char *pch2, size_t cch2,
+                      const char *pszFallback, size_t cchFallback)
+{
+    unsigned int cchValue, cchWord = 0;
+    char *pszFree;
+    const char *pszWord = NULL;
+    const char *pszValue = kbuild_tsu_lookup(pch1, cch1, pch2, cch2, "", 0, &cchValue, &pszFree);
+    struct variable *pVar;
+
+    if (pszValue)
+        pszWord = find_next_token(&pszValue, &cchWord);
+    if (!pszWord)
+    {
+        if (!pszFallback)
+            pszFallback = "";
+        pszValue = pszFallback;
+        cchWord = 0;
+        pszWord = find_next_token(&pszValue, &cchWord);
+        if (!pszWord)
+            pszWord = pszFallback;
+    }
+    pVar = define_variable_vl(pszVarName, strlen(pszVarName), pszWord, cchWord,
+                              1 /* duplicate_value */, o_local, 0 /* !recursive */);
+    free(pszFree);
+    return pVar;
+}
+
+
+/* Copies the key into the buffer, prepending a dot. */
+static size_t
+kbuild_tsu_make_key(char *pszKey, struct variable *pVar1, struct variable *pVar2)
+{
+    size_t cch = 0;
+    pszKey[cch++] = '.';
+    memcpy(&pszKey[cch], pVar1->value, pVar1->value_length);
+    cch += pVar1->value_length;
+    if (pVar2)
+    {
+        pszKey[cch++] = '.';
+        memcpy(&pszKey[cch], pVar2->value, pVar2->value_length);
+        cch += pVar2->value_length;
+    }
+    pszKey[cch] = '\0';
+    return cch;
+}
+
+/*
+ * Collects the tools, SDKs and units used by the targets and their sources,
+ * appending them to _TOOLS, _SDKS and _USES.  This is the native version of
+ * def_tools_sdks_target and def_tools_srcname_target in
+ * footer-inherit-uses-tools.kmk and must match them.
+ *
+ * Invoked like this:
+ *  $(kb-col-tools 1,$(_ALL_TARGET_TARGETS),$(KBUILD_TARGET),$(KBUILD_TARGET_ARCH),$(KBUILD_TARGET_CPU))
+ *  $(kb-col-tools 1,$(_ALL_SRCNAME_TARGETS),$(KBUILD_TARGET),$(KBUILD_TARGET_ARCH),$(KBUILD_TARGET_CPU),srcname)
+ */
+char *
+func_kbuild_collect_tools(char *o, char **argv, const char *pszFuncName)
+{
+    const char         *pszVersion = argv[0];
+    const char         *pszBldTrg  = argv[2];
+    const char         *pszBldArch = argv[3];
+    const char         *pszBldCpu  = argv[4];
+    int                 fSrcName   = 0;
+    struct variable    *pKbType;
+    struct variable    *pProps;
+    struct kbtsu_prop
+    {
+        char               *psz;    /* "_$(prop)" */
+        size_t              cch;
+    }                  *paProps;
+    unsigned int        cProps;
+    unsigned int        iProp;
+    const char         *pszProp;
+    unsigned int        cchProp;
+    struct kbuild_tsu_buf Tools = { NULL, 0, 0 };
+    struct kbuild_tsu_buf Sdks  = { NULL, 0, 0 };
+    struct kbuild_tsu_buf Uses  = { NULL, 0, 0 };
+    struct kbuild_tsu_buf Srcs  = { NULL, 0, 0 };
+    const char         *pszIter;
+    const char         *pszTarget;
+    unsigned int        cchTarget;
+    char               *pszKeys   = NULL;
+    size_t              cchKeys   = 0;
+    char               *pszTrgSrc = NULL;
+    size_t              cchTrgSrcBuf = 0;
+
+    /*
+     * Validate input.
+     */
+    if (pszVersion[0] != '1' || pszVersion[1])
+        fatal(NULL, "%s: Unsupported version `%s'", pszFuncName, pszVersion);
+    if (argv[5])
+    {
+        if (strcmp(argv[5], "srcname"))
+            fatal(NULL, "%s: Invalid mode `%s'", pszFuncName, argv[5]);
+        fSrcName = 1;
+    }
+
+    /*
+     * Prepare the tool properties, folding them into an array with the
+     * underscore prepended for quicker copying.
+     */
+    pProps = kbuild_get_variable_n(ST("PROPS_TOOLS"));
+    cProps = 0;
+    paProps = xmalloc(sizeof(*paProps) * (pProps->value_length / 2 + 1));
+    pszIter = pProps->value;
+    while ((pszProp = find_next_token(&pszIter, &cchProp)))
+    {
+        paProps[cProps].cch = cchProp + 1;
+        paProps[cProps].psz = xmalloc(cchProp + 2);
+        paProps[cProps].psz[0] = '_';
+        memcpy(paProps[cProps].psz + 1, pszProp, cchProp);
+        paProps[cProps].psz[cchProp + 1] = '\0';
+        cProps++;
+    }
+
+    pKbType = kbuild_get_variable_n(ST("KBUILD_TYPE"));
+
+    /*
+     * Iterate the target list in a new variable scope, like foreach would.
+     */
+    push_new_variable_scope();
+
+    pszIter = argv[1];
+    while ((pszTarget = find_next_token(&pszIter, &cchTarget)))
+    {
+        struct variable *pBldType, *pBldTrg, *pBldArch, *pBldCpu;
+        char *pszKeyTrg, *pszKeyTrgArch, *pszKeyArch, *pszKeyCpu, *pszKeyType, *pszKeyKbType;
+        size_t cchKeyTrg, cchKeyTrgArch, cchKeyArch, cchKeyCpu, cchKeyType, cchKeyKbType, cchMax;
+        const char *pszSrcIter, *pszSource;
+        unsigned int cchSource;
+
+        define_variable_vl("target", 6, pszTarget, cchTarget, 1 /* duplicate_value */,
+                           o_automatic, 0 /* !recursive */);
+        pBldType = kbuild_tsu_first_word("_bld_type",    pszTarget, cchTarget, ST("_BLD_TYPE"),
+                                         pKbType->value, pKbType->value_length);
+        pBldTrg  = kbuild_tsu_first_word("_bld_trg",     pszTarget, cchTarget, ST("_BLD_TRG"),
+                                         pszBldTrg, strlen(pszBldTrg));
+        pBldArch = kbuild_tsu_first_word("_bld_trg_arch", pszTarget, cchTarget, ST("_BLD_TRG_ARCH"),
+                                         pszBldArch, strlen(pszBldArch));
+        pBldCpu  = kbuild_tsu_first_word("_bld_trg_cpu", pszTarget, cchTarget, ST("_BLD_TRG_CPU"),
+                                         pszBldCpu, strlen(pszBldCpu));
+
+        /* The keys, each with a leading dot. */
+        cchMax = (pBldTrg->value_length + pBldArch->value_length + 2) * 3
+               + pBldCpu->value_length + pBldType->value_length + pKbType->value_length + 3 + 6;
+        if (cchKeys < cchMax)
+        {
+            cchKeys = (cchMax + 63U) & ~(size_t)63;
+            pszKeys = xrealloc(pszKeys, cchKeys);
+        }
+        pszKeyTrg     = pszKeys;
+        cchKeyTrg     = kbuild_tsu_make_key(pszKeyTrg, pBldTrg, NULL);
+        pszKeyTrgArch = pszKeyTrg + cchKeyTrg + 1;
+        cchKeyTrgArch = kbuild_tsu_make_key(pszKeyTrgArch, pBldTrg, pBldArch);
+        pszKeyArch    = pszKeyTrgArch + cchKeyTrgArch + 1;
+        cchKeyArch    = kbuild_tsu_make_key(pszKeyArch, pBldArch, NULL);
+        pszKeyCpu     = pszKeyArch + cchKeyArch + 1;
+        cchKeyCpu     = kbuild_tsu_make_key(pszKeyCpu, pBldCpu, NULL);
+        pszKeyType    = pszKeyCpu + cchKeyCpu + 1;
+        cchKeyType    = kbuild_tsu_make_key(pszKeyType, pBldType, NULL);
+        pszKeyKbType  = pszKeyType + cchKeyType + 1;
+        cchKeyKbType  = kbuild_tsu_make_key(pszKeyKbType, pKbType, NULL);
+
+        /*
+         * The target it self.
+         */
+        if (!fSrcName)
+        {
+            for (iProp = 0; iProp < cProps; iProp++)
+            {
+                pszProp = paProps[iProp].psz;
+                cchProp = paProps[iProp].cch;
+                kbuild_tsu_add_var(&Tools, pszTarget, cchTarget, pszProp, cchProp, pszKeyTrg, cchKeyTrg);
+                kbuild_tsu_add_var(&Tools, pszTarget, cchTarget, pszProp, cchProp, pszKeyArch, cchKeyArch);
+                kbuild_tsu_add_var(&Tools, pszTarget, cchTarget, pszProp, cchProp, pszKeyTrgArch, cchKeyTrgArch);
+                kbuild_tsu_add_var(&Tools, pszTarget, cchTarget, pszProp, cchProp, "", 0);
+            }
+
+            kbuild_tsu_add_var(&Sdks, pszTarget, cchTarget, ST("_SDKS"), pszKeyTrg, cchKeyTrg);
+            kbuild_tsu_add_var(&Sdks, pszTarget, cchTarget, ST("_SDKS"), pszKeyArch, cchKeyArch);
+            kbuild_tsu_add_var(&Sdks, pszTarget, cchTarget, ST("_SDKS"), pszKeyTrgArch, cchKeyTrgArch);
+            kbuild_tsu_add_var(&Sdks, pszTarget, cchTarget, ST("_SDKS"), "", 0);
+
+            kbuild_tsu_add_var(&Uses, pszTarget, cchTarget, ST("_USES"), pszKeyTrg, cchKeyTrg);
+            kbuild_tsu_add_var(&Uses, pszTarget, cchTarget, ST("_USES"), pszKeyArch, cchKeyArch);
+            kbuild_tsu_add_var(&Uses, pszTarget, cchTarget, ST("_USES"), pszKeyTrgArch, cchKeyTrgArch);
+            kbuild_tsu_add_var(&Uses, pszTarget, cchTarget, ST("_USES"), "", 0);
+        }
+
+        /*
+         * The sources.
+         */
+        Srcs.cch = 0;
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), pszKeyTrg, cchKeyTrg);
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), pszKeyArch, cchKeyArch);
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), pszKeyTrgArch, cchKeyTrgArch);
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), pszKeyCpu, cchKeyCpu);
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), pszKeyType, cchKeyType);
+        kbuild_tsu_add_var(&Srcs, pszTarget, cchTarget, ST("_SOURCES"), "", 0);
+
+        pszSrcIter = Srcs.psz;
+        while (Srcs.cch && (pszSource = find_next_token(&pszSrcIter, &cchSource)))
+        {
+            size_t cchTrgSrc;
+
+            if (fSrcName)
+            {
+                /* $(notdir) */
+                const char *psz = pszSource + cchSource;
+                while (psz > pszSource && psz[-1] != '/'
+#ifdef HAVE_DOS_PATHS
+                       && psz[-1] != '\\' && psz[-1] != ':'
+#endif
+                       )
+                    psz--;
+                cchSource -= psz - pszSource;
+                pszSource = psz;
+                if (!cchSource)
+                    continue;
+            }
+            define_variable_vl("source", 6, pszSource, cchSource, 1 /* duplicate_value */,
+                               o_automatic, 0 /* !recursive */);
+
+            /* $(target)_$(source) */
+            cchTrgSrc = cchTarget + 1 + cchSource;
+            if (cchTrgSrcBuf < cchTrgSrc + 1)
+            {
+                cchTrgSrcBuf = (cchTrgSrc + 1 + 63U) & ~(size_t)63;
+                pszTrgSrc = xrealloc(pszTrgSrc, cchTrgSrcBuf);
+            }
+            memcpy(pszTrgSrc, pszTarget, cchTarget);
+            pszTrgSrc[cchTarget] = '_';
+            memcpy(pszTrgSrc + cchTarget + 1, pszSource, cchSource);
+            pszTrgSrc[cchTrgSrc] = '\0';
+
+            for (iProp = 0; iProp < cProps; iProp++)
+            {
+                pszProp = paProps[iProp].psz;
+                cchProp = paProps[iProp].cch;
+                kbuild_tsu_add_var(&Tools, pszSource, cchSource, pszProp, cchProp, pszKeyTrg, cchKeyTrg);
+                kbuild_tsu_add_var(&Tools, pszTrgSrc, cchTrgSrc, pszProp, cchProp, pszKeyTrg, cchKeyTrg);
+                kbuild_tsu_add_var(&Tools, pszSource, cchSource, pszProp, cchProp, pszKeyTrgArch, cchKeyTrgArch);
+                kbuild_tsu_add_var(&Tools, pszTrgSrc, cchTrgSrc, pszProp, cchProp, pszKeyTrgArch, cchKeyTrgArch);
+                kbuild_tsu_add_var(&Tools, pszSource, cchSource, pszProp, cchProp, pszKeyArch, cchKeyArch);
+                kbuild_tsu_add_var(&Tools, pszTrgSrc, cchTrgSrc, pszProp, cchProp, pszKeyArch, cchKeyArch);
+                kbuild_tsu_add_var(&Tools, pszSource, cchSource, pszProp, cchProp, "", 0);
+                kbuild_tsu_add_var(&Tools, pszTrgSrc, cchTrgSrc, pszProp, cchProp, "", 0);
+            }
+
+#define ADD_SRC_PROP(Buf, szProp) \
+            do { \
+                kbuild_tsu_add_var(&Buf, pszSource, cchSource, ST(szProp), pszKeyTrg, cchKeyTrg); \
+                kbuild_tsu_add_var(&Buf, pszTrgSrc, cchTrgSrc, ST(szProp), pszKeyTrg, cchKeyTrg); \
+                kbuild_tsu_add_var(&Buf, pszSource, cchSource, ST(szProp), pszKeyTrgArch, cchKeyTrgArch); \
+                kbuild_tsu_add_var(&Buf, pszTrgSrc, cchTrgSrc, ST(szProp), pszKeyTrgArch, cchKeyTrgArch); \
+                kbuild_tsu_add_var(&Buf, pszSource, cchSource, ST(szProp), pszKeyArch, cchKeyArch); \
+                kbuild_tsu_add_var(&Buf, pszTrgSrc, cchTrgSrc, ST(szProp), pszKeyArch, cchKeyArch); \
+                kbuild_tsu_add_var(&Buf, pszSource, cchSource, ST(szProp), pszKeyKbType, cchKeyKbType); \
+                kbuild_tsu_add_var(&Buf, pszTrgSrc, cchTrgSrc, ST(szProp), pszKeyKbType, cchKeyKbType); \
+                kbuild_tsu_add_var(&Buf, pszSource, cchSource, ST(szProp), "", 0); \
+                kbuild_tsu_add_var(&Buf, pszTrgSrc, cchTrgSrc, ST(szProp), "", 0); \
+            } while (0)
+            ADD_SRC_PROP(Sdks, "_SDKS");
+            ADD_SRC_PROP(Uses, "_USES");
+#undef ADD_SRC_PROP
+        } /* foreach source */
+    } /* foreach target */
+
+    pop_variable_scope();
+
+    /*
+     * Append the findings to _TOOLS, _SDKS and _USES the way += would.
+     */
+    if (Tools.cch)
+        do_variable_definition_2(NILF, "_TOOLS", Tools.psz, Tools.cch, 0 /* simple_value */, NULL,
+                                 o_file, f_append, 0 /* !target_var */);
+    if (Sdks.cch)
+        do_variable_definition_2(NILF, "_SDKS", Sdks.psz, Sdks.cch, 0 /* simple_value */, NULL,
+                                 o_file, f_append, 0 /* !target_var */);
+    if (Uses.cch)
+        do_variable_definition_2(NILF, "_USES", Uses.psz, Uses.cch, 0 /* simple_value */, NULL,
+                                 o_file, f_append, 0 /* !target_var */);
+
+    /*
+     * Cleanup.
+     */
+    free(Tools.psz);
+    free(Sdks.psz);
+    free(Uses.psz);
+    free(Srcs.psz);
+    free(pszKeys);
+    free(pszTrgSrc);
+    for (iProp = 0; iProp < cProps; iProp++)
+        free(paProps[iProp].psz);
+    free(paProps);
+
+    return o;
+}
+
 #endif /* KMK_HELPERS */
 
@@ -32,6 +32,7 @@ char *func_kbuild_object_suffix(char *o, char **argv, const char *pszFuncName);
 char *func_kbuild_source_prop(char *o, char **argv, const char *pszFuncName);
 char *func_kbuild_source_one(char *o, char **argv, const char *pszFuncName);
 char *func_kbuild_expand_template(char *o, char **argv, const char *pszFuncName);
+char *func_kbuild_collect_tools(char *o, char **argv, const char *pszFuncName);
 
 void init_kbuild(int argc, char **argv);
 const char *get_kbuild_path(void);
@@ -42,6 +43,9 @@ struct kbuild_eval_data;
 extern struct kbuild_eval_data *g_pTopKbDef;
 struct variable_set *get_top_kbuild_variable_set(void);
 char *kbuild_prefix_variable(const char *pszName, unsigned int *pcchName);
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+void kbuild_prop_cache_invalidate(const char *pszName, unsigned int cchName);
+#endif
 
 int eval_kbuild_define(struct kbuild_eval_data **kdata, const struct floc *flocp,
                        const char *word, unsigned int wlen, const char *line, const char *eos, int ignoring);
@@ -207,6 +207,8 @@ int kmk_builtin_command_parsed(int argc, char **argv, char ***ppapszArgvToSpawn,
         rc = kmk_builtin_rm(argc, argv, environ);
     else if (!strcmp(pszCmd, "rmdir"))
         rc = kmk_builtin_rmdir(argc, argv, environ);
+    else if (!strcmp(pszCmd, "sed"))
+        rc = kmk_builtin_sed(argc, argv, environ);
     else if (!strcmp(pszCmd, "test"))
         rc = kmk_builtin_test(argc, argv, environ, ppapszArgvToSpawn);
     /* rarely used commands: */
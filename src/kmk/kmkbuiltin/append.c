@@ -35,6 +35,7 @@
 #endif
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #ifdef HAVE_ALLOCA_H
 # include <alloca.h>
 #endif
@@ -42,19 +43,32 @@
 #include "kmkbuiltin.h"
 
 
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The size of the output buffer.
+ * Big enough for the output of a typical invocation (e.g. the define ... endef
+ * of a compile command) to reach the file in a single write when it's closed. */
+#define APPEND_BUFFER_SIZE  0x10000
+
+
 /**
  * Prints the usage and return 1.
  */
 static int usage(FILE *pf)
 {
     fprintf(pf,
-            "usage: %s [-dcnNtv] file [string ...]\n"
+            "usage: %s [-bdcnNtv] file [string ...]\n"
             "   or: %s --version\n"
             "   or: %s --help\n"
             "\n"
             "Options:\n"
+            "  -b  Start with a newline, which leaves an empty line before the\n"
+            "      output when the file ends with one.\n"
             "  -d  Enclose the output in define ... endef, taking the name from\n"
-            "      the first argument following the file name.\n"
+            "      the first argument following the file name. The define and\n"
+            "      endef lines are always put at the start of a line, so a single\n"
+            "      '-dc file name target' invocation can replace separate appends.\n"
             "  -c  Output the command for specified target(s). [builtin only]\n"
             "  -n  Insert a newline between the strings.\n"
             "  -N  Suppress the trailing newline.\n"
@@ -66,6 +80,25 @@ static int usage(FILE *pf)
 }
 
 
+/**
+ * Checks whether the file we're appending to ends with a newline or is empty.
+ *
+ * @returns 1 if it does (or if we cannot tell), 0 if it doesn't.
+ * @param   pFile   The file, opened in "a+" mode.
+ */
+static int append_at_start_of_line(FILE *pFile)
+{
+    int ch;
+    if (fseek(pFile, 0, SEEK_END) || ftell(pFile) <= 0)
+        return 1;
+    if (fseek(pFile, -1, SEEK_END))
+        return 1;
+    ch = fgetc(pFile);
+    fseek(pFile, 0, SEEK_END); /* required before switching to output. */
+    return ch == EOF || ch == '\n';
+}
+
+
 /**
  * Appends text to a textfile, creating the textfile if necessary.
  */
@@ -75,6 +108,9 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
     int fFirst;
     int iFile;
     FILE *pFile;
+    char *pszBuf;
+    int chLast = '\n';
+    int fBlankLine = 0;
     int fNewline = 0;
     int fNoTrailingNewline = 0;
     int fTruncate = 0;
@@ -91,7 +127,7 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
     while (i < argc
        &&  argv[i][0] == '-'
        &&  argv[i][1] != '\0' /* '-' is a file */
-       &&  strchr("-cdnNtv", argv[i][1]) /* valid option char */
+       &&  strchr("-bcdnNtv", argv[i][1]) /* valid option char */
        )
     {
         char *psz = &argv[i][1];
@@ -101,6 +137,9 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
             {
                 switch (*psz)
                 {
+                    case 'b':
+                        fBlankLine = 1;
+                        break;
                     case 'c':
                         if (fVariables)
                         {
@@ -175,16 +214,32 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
      * Open the output file.
      */
     iFile = i;
-    pFile = fopen(argv[i], fTruncate ? "w" : "a");
+    pFile = fopen(argv[i], fTruncate ? "w" : fDefine ? "a+" : "a");
     if (!pFile)
         return err(1, "failed to open '%s'", argv[i]);
 
+    /*
+     * Collect all the output in one big buffer so that it's written with a
+     * single write call when the file is closed.
+     */
+    pszBuf = (char *)malloc(APPEND_BUFFER_SIZE);
+    if (pszBuf)
+        setvbuf(pFile, pszBuf, _IOFBF, APPEND_BUFFER_SIZE);
+
+    /*
+     * Leading newline?
+     */
+    if (fBlankLine)
+        fputc('\n', pFile);
+
     /*
      * Start define?
      */
     if (fDefine)
     {
         i++;
+        if (!fTruncate && !fBlankLine && !append_at_start_of_line(pFile))
+            fputc('\n', pFile);
         fprintf(pFile, "define %s\n", argv[i]);
     }
 
@@ -197,7 +252,10 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
         const char *psz = argv[i];
         size_t cch = strlen(psz);
         if (!fFirst)
-            fputc(fNewline ? '\n' : ' ', pFile);
+        {
+            chLast = fNewline ? '\n' : ' ';
+            fputc(chLast, pFile);
+        }
 #ifndef kmk_builtin_append
         if (fCommands)
         {
@@ -209,6 +267,8 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
 
             pchEnd = func_commands(variable_buffer, &argv[i], "commands");
             fwrite(variable_buffer, 1, pchEnd - variable_buffer, pFile);
+            if (pchEnd != variable_buffer)
+                chLast = pchEnd[-1];
 
             restore_variable_buffer(pszOldBuf, cchOldBuf);
         }
@@ -221,15 +281,26 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
                 &&  memchr(pVar->value, '$', pVar->value_length))
             {
                 char *pszExpanded = allocated_variable_expand(pVar->value);
-                fwrite(pszExpanded, 1, strlen(pszExpanded), pFile);
+                size_t cchExpanded = strlen(pszExpanded);
+                fwrite(pszExpanded, 1, cchExpanded, pFile);
+                if (cchExpanded)
+                    chLast = pszExpanded[cchExpanded - 1];
                 free(pszExpanded);
             }
             else
+            {
                 fwrite(pVar->value, 1, pVar->value_length, pFile);
+                if (pVar->value_length)
+                    chLast = pVar->value[pVar->value_length - 1];
+            }
         }
         else
 #endif
+        {
             fwrite(psz, 1, cch, pFile);
+            if (cch)
+                chLast = psz[cch - 1];
+        }
         fFirst = 0;
     }
 
@@ -238,7 +309,7 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
      */
     if (fDefine)
     {
-        if (fFirst)
+        if (fFirst || chLast != '\n')
             fwrite("\nendef", 1, sizeof("\nendef") - 1, pFile);
         else
             fwrite("endef", 1, sizeof("endef") - 1, pFile);
@@ -252,10 +323,15 @@ int kmk_builtin_append(int argc, char **argv, char **envp)
         ||  ferror(pFile))
     {
         fclose(pFile);
+        free(pszBuf);
         return errx(1, "error writing to '%s'!", argv[iFile]);
     }
     if (fclose(pFile))
+    {
+        free(pszBuf);
         return err(1, "failed to fclose '%s'!", argv[iFile]);
+    }
+    free(pszBuf);
     return 0;
 }
 
@@ -195,6 +195,13 @@ static big_int make_start_ts = -1;
 int print_time_width = 5;
 #endif
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+/* How to group the output of parallel jobs (--output-sync).  */
+
+int output_sync = OUTPUT_SYNC_NONE;
+static struct stringlist *output_sync_option = 0;
+#endif
+
 /* Print debugging info (--debug).  */
 
 static struct stringlist *db_flags;
@@ -421,6 +428,12 @@ static const char *const usage[] =
     N_("\
   -o FILE, --old-file=FILE, --assume-old=FILE\n\
                               Consider FILE to be very old and don't remake it.\n"),
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+    N_("\
+  -O[TYPE], --output-sync[=TYPE]\n\
+                              Synchronize output of parallel jobs by TYPE:\n\
+                                line, target (default), recurse or none.\n"),
+#endif
     N_("\
   -p, --print-data-base       Print make's internal database.\n"),
     N_("\
@@ -511,6 +524,9 @@ static const struct command_switch switches[] =
     { 'm', ignore, 0, 0, 0, 0, 0, 0, 0 },
     { 'n', flag, &just_print_flag, 1, 1, 1, 0, 0, "just-print" },
     { 'o', filename, &old_files, 0, 0, 0, 0, 0, "old-file" },
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+    { 'O', string, &output_sync_option, 1, 1, 0, "target", 0, "output-sync" },
+#endif
     { 'p', flag, &print_data_base_flag, 1, 1, 0, 0, 0, "print-data-base" },
 #ifdef CONFIG_PRETTY_COMMAND_PRINTING
     { CHAR_MAX+10, flag, (char *) &pretty_command_printing, 1, 1, 1, 0, 0,
@@ -787,6 +803,30 @@ debug_signal_handler (int sig UNUSED)
 }
 #endif
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+static void
+decode_output_sync_flags (void)
+{
+  const char *p;
+
+  if (!output_sync_option)
+    return;
+
+  /* The last one given wins.  */
+  p = output_sync_option->list[output_sync_option->idx - 1];
+  if (!strcmp (p, "none"))
+    output_sync = OUTPUT_SYNC_NONE;
+  else if (!strcmp (p, "line"))
+    output_sync = OUTPUT_SYNC_LINE;
+  else if (!strcmp (p, "target"))
+    output_sync = OUTPUT_SYNC_TARGET;
+  else if (!strcmp (p, "recurse"))
+    output_sync = OUTPUT_SYNC_RECURSE;
+  else
+    fatal (NILF, _("unknown output-sync type `%s'"), p);
+}
+#endif
+
 static void
 decode_debug_flags (void)
 {
@@ -1777,6 +1817,9 @@ main (int argc, char **argv, char **envp)
 #endif
 
   decode_debug_flags ();
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  decode_output_sync_flags ();
+#endif
 
 #ifdef KMK
   set_make_priority_and_affinity ();
@@ -2297,6 +2340,9 @@ main (int argc, char **argv, char **envp)
   decode_env_switches (STRING_SIZE_TUPLE ("MFLAGS"));
 #endif
 #endif /* !KMK */
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+  decode_output_sync_flags ();
+#endif
 
 #if defined (__MSDOS__) || defined (__EMX__)
   if (job_slots != 1
@@ -2509,6 +2555,10 @@ main (int argc, char **argv, char **envp)
 	    if (f->double_colon)
 	      for (f = f->double_colon; f != NULL; f = f->prev)
 		{
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+		  if (f->deps_pending)
+		    expand_pending_deps (f);
+#endif
 		  if (f->deps == 0 && f->cmds != 0)
 		    {
 		      /* This makefile is a :: target with commands, but
@@ -3921,6 +3971,11 @@ die (int status)
 
       dying = 1;
 
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+      /* We might be dying while collecting the output of a job.  */
+      output_end ();
+#endif
+
       if (print_version_flag)
 	print_version ();
 
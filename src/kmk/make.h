@@ -577,6 +577,21 @@ int file_exists_p (const char *);
 int file_impossible_p (const char *);
 void file_impossible (const char *);
 const char *dir_name (const char *);
+#ifdef CONFIG_WITH_GLOB_CACHE
+int dir_glob_cache_lookup (const char *, int *, const char ***);
+void dir_glob_cache_store (const char *, unsigned int, char **);
+#endif
+#if defined (CONFIG_WITH_VPATH_INDEX) \
+ && (   defined (WINDOWS32) || defined (VMS) || defined (__MSDOS__) \
+     || defined (__EMX__) || defined (HAVE_CASE_INSENSITIVE_FS))
+# undef CONFIG_WITH_VPATH_INDEX /* see dir_index_create */
+#endif
+#ifdef CONFIG_WITH_VPATH_INDEX
+struct dir_index;
+struct dir_index *dir_index_create (const char **);
+int dir_index_lookup (struct dir_index *, const char *);
+void dir_index_free (struct dir_index *);
+#endif
 void hash_init_directories (void);
 
 void define_default_variables (void);
@@ -765,6 +780,13 @@ extern int pretty_command_printing;
 #ifdef CONFIG_WITH_PRINT_TIME_SWITCH
 extern int print_time_min, print_time_width;
 #endif
+#ifdef CONFIG_WITH_OUTPUT_SYNC
+# define OUTPUT_SYNC_NONE    0
+# define OUTPUT_SYNC_LINE    1
+# define OUTPUT_SYNC_TARGET  2
+# define OUTPUT_SYNC_RECURSE 3
+extern int output_sync;
+#endif
 #if defined (CONFIG_WITH_MAKE_STATS) || defined (CONFIG_WITH_MINIMAL_STATS)
 extern int make_expensive_statistics;
 #endif
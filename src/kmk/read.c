@@ -587,6 +587,73 @@ eval_buffer (char *buffer, char *eos)
 
   alloca (0);
 }
+
+#ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+/* Record the explicit rule `TARGETS: DEPSTR' with the recipe COMMANDS
+   without going thru eval.  This is for callers (kb-src-one) that have
+   already got the fully expanded pieces eval would extract from a rule
+   line, so they don't have to paste them into a buffer that is then
+   parsed all over again.
+
+   TARGETS is parsed like the target list of a rule line and may thus
+   contain the `+' and `+|' explicit multitarget operators.  DEPSTR is
+   an xmalloc'ed string which is consumed, or NULL.  COMMANDS is the
+   recipe the way eval collects it: recipe prefixes removed and each
+   line newline terminated.  */
+
+void
+eval_kbuild_rule (char *targets, char *depstr, const char *commands,
+                  unsigned int commands_idx)
+{
+  struct nameseq *filenames;
+  struct floc fi;
+
+  if (reading_file)
+    fi = *reading_file;
+  else
+    {
+      fi.filenm = NULL;
+      fi.lineno = 0;
+    }
+
+  filenames = PARSE_FILE_SEQ (&targets, struct nameseq, '\0', NULL, 0);
+  if (!filenames)
+    {
+      if (depstr)
+        free (depstr);
+      return;
+    }
+
+  record_files (filenames, NULL, NULL, depstr, fi.lineno,
+                (char *)commands, commands_idx, 0, &fi);
+}
+
+/* Record the target-specific variable definition DEFN (`name = value')
+   for TARGETS without going thru eval.  */
+
+void
+eval_kbuild_target_var (char *targets, char *defn)
+{
+  struct nameseq *filenames;
+  struct vmodifiers vmod;
+  struct floc fi;
+
+  if (reading_file)
+    fi = *reading_file;
+  else
+    {
+      fi.filenm = NULL;
+      fi.lineno = 0;
+    }
+
+  filenames = PARSE_FILE_SEQ (&targets, struct nameseq, '\0', NULL, 0);
+  if (!filenames)
+    return;
+
+  memset (&vmod, '\0', sizeof (vmod));
+  record_target_var (filenames, defn, o_file, &vmod, &fi);
+}
+#endif /* CONFIG_WITH_KBUILD_DIRECT_RULES */
 
 /* Check LINE to see if it's a variable assignment or undefine.
 
@@ -3643,6 +3710,9 @@ parse_file_seq (char **stringp, unsigned int size, int stopchar,
       char *s;
       int nlen;
       int i;
+#ifdef CONFIG_WITH_GLOB_CACHE
+      int cached;
+#endif
 
       /* Skip whitespace; at the end of the string or STOPCHAR we're done.  */
       p = next_token (p);
@@ -3844,6 +3914,19 @@ parse_file_seq (char **stringp, unsigned int size, int stopchar,
 	}
 #endif /* !NO_ARCHIVES */
 
+#ifdef CONFIG_WITH_GLOB_CACHE
+      /* Repeated patterns are usually answered by the glob cache.  */
+      cached = dir_glob_cache_lookup (name, &i, &nlist);
+      if (cached)
+        {
+          if (i == 0 && !(flags & PARSEFS_EXISTS))
+            {
+              i = 1;
+              nlist = &name;
+            }
+        }
+      else
+#endif
       switch (glob (name, GLOB_NOSORT|GLOB_ALTDIRFUNC, NULL, &gl))
 	{
 	case GLOB_NOSPACE:
@@ -3853,9 +3936,15 @@ parse_file_seq (char **stringp, unsigned int size, int stopchar,
           /* Success.  */
           i = gl.gl_pathc;
           nlist = (const char **)gl.gl_pathv;
+#ifdef CONFIG_WITH_GLOB_CACHE
+          dir_glob_cache_store (name, gl.gl_pathc, gl.gl_pathv);
+#endif
           break;
 
         case GLOB_NOMATCH:
+#ifdef CONFIG_WITH_GLOB_CACHE
+          dir_glob_cache_store (name, 0, NULL);
+#endif
           /* If we want only existing items, skip this one.  */
           if (flags & PARSEFS_EXISTS)
             {
@@ -3906,6 +3995,9 @@ parse_file_seq (char **stringp, unsigned int size, int stopchar,
 #endif /* !NO_ARCHIVES */
           NEWELT (concat (2, prefix, nlist[i]));
 
+#ifdef CONFIG_WITH_GLOB_CACHE
+      if (!cached)
+#endif
         globfree (&gl);
 
 #ifndef NO_ARCHIVES
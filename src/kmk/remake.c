@@ -353,6 +353,10 @@ update_file (struct file *file, unsigned int depth)
 
         f->considered = considered;
 
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+        if (f->deps_pending)
+          expand_pending_deps (f);
+#endif
         for (d = f->deps; d != 0; d = d->next)
           status |= update_file (d->file, depth + 1);
       }
@@ -573,6 +577,13 @@ update_file_1 (struct file *file, unsigned int depth)
 
   must_make = noexist;
 
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+  /* Do the second expansion of the prerequisites now if snap_deps left it
+     to us.  The implicit rule search below looks at them.  */
+  if (file->deps_pending)
+    expand_pending_deps (file);
+#endif
+
   /* If file was specified as a target with no commands,
      come up with some default commands.  */
 
@@ -613,6 +624,10 @@ update_file_1 (struct file *file, unsigned int depth)
       struct dep *lastd = 0;
 
       /* Find the deps we're scanning */
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+      if (ad->file->deps_pending)
+        expand_pending_deps (ad->file);
+#endif
       d = ad->file->deps;
       ad = ad->next;
 
@@ -1340,6 +1355,10 @@ check_dep (struct file *file, unsigned int depth,
       /* FILE is an intermediate file.  */
       FILE_TIMESTAMP mtime;
 
+#ifdef CONFIG_WITH_LAZY_2ND_EXPANSION
+      if (file->deps_pending)
+        expand_pending_deps (file);
+#endif
       if (!file->phony && file->cmds == 0 && !file->tried_implicit)
 	{
 	  if (try_implicit_rule (file, depth))
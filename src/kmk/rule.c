@@ -53,6 +53,19 @@ unsigned int max_pattern_deps;
 
 unsigned int max_pattern_dep_length;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+/* Index of the pattern rule targets by the last character of the target.
+   The targets ending with `%' can match any name and are put at the end,
+   after the 256 character buckets.  The references are in definition
+   order within each bucket.  The index is rebuilt on demand after the
+   pattern rules have been changed.  */
+
+static struct rule_target_ref *rule_index_refs;
+static unsigned int rule_index_size;
+static unsigned int rule_index_offsets[256 + 2];
+static int rule_index_valid;
+#endif
+
 /* Pointer to structure for the file .SUFFIXES
    whose dependencies are the suffixes to be searched.  */
 
@@ -293,6 +306,10 @@ new_pattern_rule (struct rule *rule, int override)
 
   rule->next = 0;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  rule_index_valid = 0;
+#endif
+
   /* Search for an identical rule.  */
   lastrule = 0;
   for (r = pattern_rules; r != 0; lastrule = r, r = r->next)
@@ -409,6 +426,10 @@ freerule (struct rule *rule, struct rule *lastrule)
 {
   struct rule *next = rule->next;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  rule_index_valid = 0;
+#endif
+
   free_dep_chain (rule->deps);
 
   /* MSVC erroneously warns without a cast here.  */
@@ -480,6 +501,85 @@ create_pattern_rule (const char **targets, const char **target_percents,
 #endif
 }
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+
+/* Returns the pattern rule index bucket for target TI of RULE.  */
+
+static unsigned int
+rule_index_bucket (struct rule *rule, unsigned int ti)
+{
+  if (rule->suffixes[ti][0] == '\0')
+    return 256;
+  return (unsigned char) rule->targets[ti][rule->lens[ti] - 1];
+}
+
+/* (Re)builds the pattern rule index.  */
+
+static void
+build_pattern_rule_index (void)
+{
+  struct rule *rule;
+  unsigned int ti, i, seq;
+
+  /* Count the targets in each bucket, then turn the counts into offsets
+     so that we can fill in the references in definition order.  */
+  memset (rule_index_offsets, 0, sizeof (rule_index_offsets));
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      rule_index_offsets[rule_index_bucket (rule, ti) + 1]++;
+  for (i = 1; i < sizeof (rule_index_offsets) / sizeof (rule_index_offsets[0]); i++)
+    rule_index_offsets[i] += rule_index_offsets[i - 1];
+
+  if (rule_index_offsets[256 + 1] > rule_index_size)
+    {
+      rule_index_size = rule_index_offsets[256 + 1] + 16;
+      rule_index_refs = xrealloc (rule_index_refs,
+                                  rule_index_size * sizeof (rule_index_refs[0]));
+    }
+
+  seq = 0;
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      {
+        unsigned int bucket = rule_index_bucket (rule, ti);
+        struct rule_target_ref *ref = &rule_index_refs[rule_index_offsets[bucket]++];
+        ref->rule = rule;
+        ref->ti = ti;
+        ref->seq = seq++;
+      }
+
+  /* The fill pass advanced each offset to the start of the next bucket.  */
+  for (i = 256 + 1; i > 0; i--)
+    rule_index_offsets[i] = rule_index_offsets[i - 1];
+  rule_index_offsets[0] = 0;
+
+  rule_index_valid = 1;
+}
+
+/* Sets up C for iterating the pattern rule targets that may match a file
+   named NAME (NAMELEN long), i.e. the targets ending with the same character
+   as NAME and the ones ending with `%'.  Returns the number of such targets,
+   which may be zero.  The iteration must be completed before any pattern
+   rules are added or removed.  */
+
+unsigned int
+pattern_rule_candidates (struct rule_candidates *c, const char *name,
+                         unsigned int namelen)
+{
+  unsigned int bucket = namelen ? (unsigned char) name[namelen - 1] : 0;
+
+  if (!rule_index_valid)
+    build_pattern_rule_index ();
+
+  c->cur     = &rule_index_refs[rule_index_offsets[bucket]];
+  c->cur_end = &rule_index_refs[rule_index_offsets[bucket + 1]];
+  c->any     = &rule_index_refs[rule_index_offsets[256]];
+  c->any_end = &rule_index_refs[rule_index_offsets[256 + 1]];
+  return (c->cur_end - c->cur) + (c->any_end - c->any);
+}
+
+#endif /* CONFIG_WITH_PATTERN_RULE_INDEX */
+
 /* Print the data base of rules.  */
 
 static void			/* Useful to call from gdb.  */
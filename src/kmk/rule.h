@@ -32,6 +32,26 @@ struct rule
     char in_use;		/* If in use by a parent pattern_search.  */
   };
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+/* Reference to a pattern rule target in the pattern rule index.  */
+
+struct rule_target_ref
+  {
+    struct rule *rule;
+    unsigned int ti;            /* Index of the target in RULE.  */
+    unsigned int seq;           /* Definition order of the target.  */
+  };
+
+/* The pattern rule targets that may match a name, see
+   pattern_rule_candidates.  */
+
+struct rule_candidates
+  {
+    const struct rule_target_ref *cur, *cur_end; /* Ending with the same char.  */
+    const struct rule_target_ref *any, *any_end; /* Ending with `%'.  */
+  };
+#endif
+
 /* For calling install_pattern_rule.  */
 struct pspec
   {
@@ -57,3 +77,7 @@ void install_pattern_rule (struct pspec *p, int terminal);
 void create_pattern_rule (const char **targets, const char **target_percents,
                           unsigned int num, int terminal, struct dep *deps,
                           struct commands *commands, int override);
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+unsigned int pattern_rule_candidates (struct rule_candidates *c, const char *name,
+                                      unsigned int namelen);
+#endif
@@ -266,7 +266,11 @@ void strcache_init (void)
 #else
                  0,             /* case insensitive */
 #endif
+#ifdef STRCACHE2_THREAD_SAFE
+                 1);            /* thread safe (includedep workers) */
+#else
                  0);            /* thread safe */
+#endif
 
   /* .SUFFIXES is referenced in several loops, keep the added pointer in a
      global var so these can be optimized. */
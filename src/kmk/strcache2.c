@@ -44,6 +44,10 @@ typedef signed int     int32_t;
 # include <stdint.h>
 #endif
 
+#if defined (STRCACHE2_THREAD_SAFE) && !defined (WINDOWS32) && !defined (__OS2__)
+# define HAVE_PTHREAD
+#endif
+
 #ifdef WINDOWS32
 # include <io.h>
 # include <process.h>
@@ -69,9 +73,42 @@ typedef signed int     int32_t;
 #define STRCACHE2_HASH_SHIFT            16
 /** Does the modding / masking of a hash number into an index. */
 #ifdef STRCACHE2_USE_MASK
-# define STRCACHE2_MOD_IT(cache, hash)  ((hash) & (cache)->hash_mask)
+# define STRCACHE2_MOD_BY(hash, mask)   ((hash) & (mask))
+# define STRCACHE2_MOD_MEMBER           hash_mask
+#else
+# define STRCACHE2_MOD_BY(hash, div)    ((hash) % (div))
+# define STRCACHE2_MOD_MEMBER           hash_div
+#endif
+#define STRCACHE2_MOD_IT(cache, hash)   STRCACHE2_MOD_BY (hash, (cache)->STRCACHE2_MOD_MEMBER)
+
+/** Memory access ordering for the lock-free readers of thread safe caches.
+ * The loads are all of pointer or int sized, naturally aligned variables. */
+#if !defined (STRCACHE2_THREAD_SAFE)
+# define STRCACHE2_LOAD_ACQ(type, var)          (var)
+# define STRCACHE2_STORE_REL(type, var, val)    do { (var) = (val); } while (0)
+# define STRCACHE2_FENCE_ACQ()                  do { } while (0)
+# define STRCACHE2_FENCE_REL()                  do { } while (0)
+#elif defined (__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+# define STRCACHE2_LOAD_ACQ(type, var)          __atomic_load_n (&(var), __ATOMIC_ACQUIRE)
+# define STRCACHE2_STORE_REL(type, var, val)    __atomic_store_n (&(var), (val), __ATOMIC_RELEASE)
+# define STRCACHE2_FENCE_ACQ()                  __atomic_thread_fence (__ATOMIC_ACQUIRE)
+# define STRCACHE2_FENCE_REL()                  __atomic_thread_fence (__ATOMIC_RELEASE)
+#elif defined (_MSC_VER) || defined (__i386__) || defined (__x86_64__)
+  /* x86 and AMD64 only reorder loads with older stores, so volatile
+     accesses plus a compiler barrier will do here. */
+# ifdef _MSC_VER
+#  include <intrin.h>
+#  define STRCACHE2_COMPILER_BARRIER()          _ReadWriteBarrier ()
+# else
+#  define STRCACHE2_COMPILER_BARRIER()          __asm__ __volatile__ ("" : : : "memory")
+# endif
+# define STRCACHE2_LOAD_ACQ(type, var)          (*(type volatile *)&(var))
+# define STRCACHE2_STORE_REL(type, var, val) \
+    do { STRCACHE2_COMPILER_BARRIER (); *(type volatile *)&(var) = (val); } while (0)
+# define STRCACHE2_FENCE_ACQ()                  STRCACHE2_COMPILER_BARRIER ()
+# define STRCACHE2_FENCE_REL()                  STRCACHE2_COMPILER_BARRIER ()
 #else
-# define STRCACHE2_MOD_IT(cache, hash)  ((hash) % (cache)->hash_div)
+# error "Port me: STRCACHE2_LOAD_ACQ & friends"
 #endif
 
 # if defined(__amd64__) || defined(__x86_64__) || defined(__AMD64__) || defined(_M_X64) || defined(__amd64) \
@@ -91,6 +128,133 @@ typedef signed int     int32_t;
 static struct strcache2 *strcache_head;
 
 
+#ifdef STRCACHE2_THREAD_SAFE
+
+/* Creates the insert lock of a thread safe cache. */
+static void
+strcache2_lock_init (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD)
+  pthread_mutex_t *mtx = xmalloc (sizeof (*mtx));
+  pthread_mutex_init (mtx, NULL);
+#elif defined (WINDOWS32)
+  CRITICAL_SECTION *mtx = xmalloc (sizeof (*mtx));
+  InitializeCriticalSection (mtx);
+#elif defined (__OS2__)
+  _fmutex *mtx = xmalloc (sizeof (*mtx));
+  _fmutex_create (mtx, 0);
+#endif
+  cache->lock = mtx;
+}
+
+/* Destroys the insert lock of a thread safe cache. */
+static void
+strcache2_lock_term (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD)
+  pthread_mutex_destroy ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+  DeleteCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+  _fmutex_close ((_fmutex *)cache->lock);
+#endif
+  free (cache->lock);
+  cache->lock = NULL;
+}
+
+MY_INLINE void
+strcache2_lock (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD)
+  pthread_mutex_lock ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+  EnterCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+  _fmutex_request ((_fmutex *)cache->lock, 0);
+#endif
+}
+
+MY_INLINE void
+strcache2_unlock (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD)
+  pthread_mutex_unlock ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+  LeaveCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+  _fmutex_release ((_fmutex *)cache->lock);
+#endif
+}
+
+/* Searches the hash chain for an exact match while owning the lock.
+   This is the fallback of the lock-free paths in thread safe caches. */
+static struct strcache2_entry *
+strcache2_find_locked (struct strcache2 *cache, const char *str,
+                       unsigned int length, unsigned int hash)
+{
+  struct strcache2_entry *entry;
+  for (entry = cache->hash_tab[STRCACHE2_MOD_IT (cache, hash)]; entry; entry = entry->next)
+    if (   entry->hash == hash
+        && entry->length == length
+        && !memcmp (entry + 1, str, length))
+      break;
+  return entry;
+}
+
+#endif /* STRCACHE2_THREAD_SAFE */
+
+/* Gets the head of the hash chain for HASH, returning the table index in
+   *IDXP.  In a thread safe cache this may race a rehash, in which case the
+   chain could be the wrong one, but the index is always within the table
+   since the rehasher publishes the table before the new mask / divisor. */
+MY_INLINE struct strcache2_entry *
+strcache2_chain_head (struct strcache2 *cache, unsigned int hash, unsigned int *idxp)
+{
+  unsigned int mod = STRCACHE2_LOAD_ACQ (unsigned int, cache->STRCACHE2_MOD_MEMBER);
+  struct strcache2_entry **tab = STRCACHE2_LOAD_ACQ (struct strcache2_entry **, cache->hash_tab);
+  unsigned int idx = STRCACHE2_MOD_BY (hash, mod);
+  *idxp = idx;
+  return STRCACHE2_LOAD_ACQ (struct strcache2_entry *, tab[idx]);
+}
+
+/* Samples the rehash sequence number before a lookup. */
+MY_INLINE unsigned int
+strcache2_rehash_seq (struct strcache2 *cache)
+{
+#ifdef STRCACHE2_THREAD_SAFE
+  if (cache->lock)
+    return STRCACHE2_LOAD_ACQ (unsigned int, cache->rehash_seq);
+#endif
+  (void)cache;
+  return 0;
+}
+
+/* Deals with a lookup miss.  The chains of a thread safe cache may have
+   been relinked by a rehash while we were walking them, if so the lookup
+   is redone while owning the lock. */
+MY_INLINE const char *
+strcache2_lookup_miss (struct strcache2 *cache, const char *str,
+                       unsigned int length, unsigned int hash, unsigned int seq)
+{
+#ifdef STRCACHE2_THREAD_SAFE
+  if (cache->lock)
+    {
+      STRCACHE2_FENCE_ACQ ();
+      if ((seq & 1) || seq != cache->rehash_seq)
+        {
+          struct strcache2_entry *entry;
+          strcache2_lock (cache);
+          entry = strcache2_find_locked (cache, str, length, hash);
+          strcache2_unlock (cache);
+          return entry ? (const char *)(entry + 1) : NULL;
+        }
+    }
+#endif
+  (void)cache; (void)str; (void)length; (void)hash; (void)seq;
+  return NULL;
+}
+
+
 /** Finds the closest primary number for power of two value (or something else
  *  useful if not support).   */
 MY_INLINE unsigned int strcache2_find_prime(unsigned int shift)
@@ -632,26 +796,36 @@ static void
 strcache2_rehash (struct strcache2 *cache)
 {
   unsigned int src = cache->hash_size;
+  unsigned int dst_size = src << 1;
   struct strcache2_entry **src_tab = cache->hash_tab;
   struct strcache2_entry **dst_tab;
+  unsigned int dst_mod;
 #ifndef STRCACHE2_USE_MASK
   unsigned int hash_shift;
 #endif
 
-  /* Allocate a new hash table twice the size of the current. */
-  cache->hash_size <<= 1;
+  /* Allocate a new hash table twice the size of the current. (The extra
+     entry at the end is for linking retired tables, see below.) */
 #ifdef STRCACHE2_USE_MASK
-  cache->hash_mask <<= 1;
-  cache->hash_mask |= 1;
+  dst_mod = (cache->hash_mask << 1) | 1;
 #else
-  for (hash_shift = 1; (1U << hash_shift) < cache->hash_size; hash_shift++)
+  for (hash_shift = 1; (1U << hash_shift) < dst_size; hash_shift++)
     /* nothing */;
-  cache->hash_div = strcache2_find_prime (hash_shift);
+  dst_mod = strcache2_find_prime (hash_shift);
+#endif
+  dst_tab = (struct strcache2_entry **)
+    xmalloc ((dst_size + 1) * sizeof (struct strcache2_entry *));
+  memset (dst_tab, '\0', (dst_size + 1) * sizeof (struct strcache2_entry *));
+
+#ifdef STRCACHE2_THREAD_SAFE
+  /* Lock-free readers may be walking the chains we're about to relink,
+     make them double check any misses. */
+  if (cache->lock)
+    {
+      cache->rehash_seq++;
+      STRCACHE2_FENCE_REL ();
+    }
 #endif
-  cache->rehash_count <<= 1;
-  cache->hash_tab = dst_tab = (struct strcache2_entry **)
-    xmalloc (cache->hash_size * sizeof (struct strcache2_entry *));
-  memset (dst_tab, '\0', cache->hash_size * sizeof (struct strcache2_entry *));
 
   /* Copy the entries from the old to the new hash table. */
   cache->collision_count = 0;
@@ -661,7 +835,7 @@ strcache2_rehash (struct strcache2 *cache)
       while (entry)
         {
           struct strcache2_entry *next = entry->next;
-          unsigned int dst = STRCACHE2_MOD_IT (cache, entry->hash);
+          unsigned int dst = STRCACHE2_MOD_BY (entry->hash, dst_mod);
           if ((entry->next = dst_tab[dst]) != 0)
             cache->collision_count++;
           dst_tab[dst] = entry;
@@ -670,6 +844,26 @@ strcache2_rehash (struct strcache2 *cache)
         }
     }
 
+  /* Switch to the new table.  The table goes first so that nobody will
+     index the old table using the new mask / divisor. */
+  STRCACHE2_STORE_REL (struct strcache2_entry **, cache->hash_tab, dst_tab);
+  STRCACHE2_STORE_REL (unsigned int, cache->STRCACHE2_MOD_MEMBER, dst_mod);
+  cache->hash_size = dst_size;
+  cache->rehash_count <<= 1;
+
+#ifdef STRCACHE2_THREAD_SAFE
+  if (cache->lock)
+    {
+      STRCACHE2_STORE_REL (unsigned int, cache->rehash_seq, cache->rehash_seq + 1);
+
+      /* Readers may still be looking at the old table, so keep it around
+         till the cache is terminated. */
+      src_tab[dst_size / 2] = (struct strcache2_entry *)cache->old_tabs;
+      cache->old_tabs = src_tab;
+      return;
+    }
+#endif
+
   /* That's it, just free the old table and we're done. */
   free (src_tab);
 }
@@ -703,7 +897,7 @@ strcache2_new_seg (struct strcache2 *cache, unsigned int minlen)
   seg->avail  = seg->size;
 
   seg->next = cache->seg_head;
-  cache->seg_head = seg;
+  STRCACHE2_STORE_REL (struct strcache2_seg *, cache->seg_head, seg);
 
   return seg;
 }
@@ -719,6 +913,22 @@ strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
   unsigned int size;
   char *str_copy;
 
+#ifdef STRCACHE2_THREAD_SAFE
+  /* Someone might have beaten us to it, or rehashed the table, since the
+     lock-free lookup.  So, redo it now that we own the lock. */
+  if (cache->lock)
+    {
+      strcache2_lock (cache);
+      entry = strcache2_find_locked (cache, str, length, hash);
+      if (entry)
+        {
+          strcache2_unlock (cache);
+          return (const char *)(entry + 1);
+        }
+      idx = STRCACHE2_MOD_IT (cache, hash);
+    }
+#endif
+
   /* Allocate space for the string. */
 
   size = length + 1 + sizeof (struct strcache2_entry);
@@ -749,11 +959,15 @@ strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
 
   if ((entry->next = cache->hash_tab[idx]) != 0)
     cache->collision_count++;
-  cache->hash_tab[idx] = entry;
+  STRCACHE2_STORE_REL (struct strcache2_entry *, cache->hash_tab[idx], entry);
   cache->count++;
   if (cache->count >= cache->rehash_count)
     strcache2_rehash (cache);
 
+#ifdef STRCACHE2_THREAD_SAFE
+  if (cache->lock)
+    strcache2_unlock (cache);
+#endif
   return str_copy;
 }
 
@@ -772,8 +986,7 @@ strcache2_add (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -821,8 +1034,7 @@ strcache2_add_hashed (struct strcache2 *cache, const char *str,
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -856,6 +1068,7 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
   struct strcache2_entry const *entry;
   unsigned int hash = strcache2_case_sensitive_hash (str, length);
   unsigned int idx;
+  unsigned int seq;
 
   assert (!cache->case_insensitive);
   assert (!memchr (str, '\0', length));
@@ -864,17 +1077,17 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  seq = strcache2_rehash_seq (cache);
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, seq);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
   entry = entry->next;
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, seq);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_2nd_count++);
@@ -884,7 +1097,7 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
     {
       entry = entry->next;
       if (!entry)
-        return NULL;
+        return strcache2_lookup_miss (cache, str, length, hash, seq);
       if (strcache2_is_equal (cache, entry, str, length, hash))
         return (const char *)(entry + 1);
       MAKE_STATS (cache->collision_3rd_count++);
@@ -909,8 +1122,7 @@ strcache2_iadd (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -958,8 +1170,7 @@ strcache2_iadd_hashed (struct strcache2 *cache, const char *str,
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -993,6 +1204,7 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
   struct strcache2_entry const *entry;
   unsigned int hash = strcache2_case_insensitive_hash (str, length);
   unsigned int idx;
+  unsigned int seq;
 
   assert (cache->case_insensitive);
   assert (!memchr (str, '\0', length));
@@ -1001,17 +1213,17 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
 
   /* Lookup the entry in the hash table, hoping for an
      early match. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  seq = strcache2_rehash_seq (cache);
+  entry = strcache2_chain_head (cache, hash, &idx);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, seq);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
   entry = entry->next;
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, seq);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_2nd_count++);
@@ -1021,7 +1233,7 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
     {
       entry = entry->next;
       if (!entry)
-        return NULL;
+        return strcache2_lookup_miss (cache, str, length, hash, seq);
       if (strcache2_is_equal (cache, entry, str, length, hash))
         return (const char *)(entry + 1);
       MAKE_STATS (cache->collision_3rd_count++);
@@ -1041,7 +1253,7 @@ strcache2_is_cached (struct strcache2 *cache, const char *str)
       /* Check the segment list and consider the question answered if the
          string is within one of them. (Could check it more thoroughly...) */
       struct strcache2_seg const *seg;
-      for (seg = cache->seg_head; seg; seg = seg->next)
+      for (seg = STRCACHE2_LOAD_ACQ (struct strcache2_seg *, cache->seg_head); seg; seg = seg->next)
         if ((size_t)(str - seg->start) < seg->size)
             return 1;
     }
@@ -1117,7 +1329,9 @@ strcache2_init (struct strcache2 *cache, const char *name, unsigned int size,
                 unsigned int def_seg_size, int case_insensitive, int thread_safe)
 {
   unsigned hash_shift;
+#ifndef STRCACHE2_THREAD_SAFE
   assert (!thread_safe);
+#endif
 
   /* calc the size as a power of two */
   if (!size)
@@ -1156,13 +1370,19 @@ strcache2_init (struct strcache2 *cache, const char *name, unsigned int size,
   cache->hash_size = 1U << hash_shift;
   cache->def_seg_size = def_seg_size;
   cache->lock = NULL;
+  cache->rehash_seq = 0;
+  cache->old_tabs = NULL;
   cache->name = name;
 
   /* allocate the hash table and first segment. */
   cache->hash_tab = (struct strcache2_entry **)
-    xmalloc (cache->init_size * sizeof (struct strcache2_entry *));
-  memset (cache->hash_tab, '\0', cache->init_size * sizeof (struct strcache2_entry *));
+    xmalloc ((cache->init_size + 1) * sizeof (struct strcache2_entry *));
+  memset (cache->hash_tab, '\0', (cache->init_size + 1) * sizeof (struct strcache2_entry *));
   strcache2_new_seg (cache, 0);
+#ifdef STRCACHE2_THREAD_SAFE
+  if (thread_safe)
+    strcache2_lock_init (cache);
+#endif
 
   /* link it */
   cache->next = strcache_head;
@@ -1196,8 +1416,25 @@ strcache2_term (struct strcache2 *cache)
     }
   while (cache->seg_head);
 
-  /* free the hash and clear the structure. */
+  /* free the hash tables and the lock and clear the structure. */
   free (cache->hash_tab);
+#ifdef STRCACHE2_THREAD_SAFE
+  if (cache->old_tabs)
+    {
+      unsigned int size = cache->hash_size;
+      struct strcache2_entry **tab = cache->old_tabs;
+      do
+        {
+          struct strcache2_entry **free_it = tab;
+          size >>= 1;
+          tab = (struct strcache2_entry **)tab[size];
+          free (free_it);
+        }
+      while (tab);
+    }
+  if (cache->lock)
+    strcache2_lock_term (cache);
+#endif
   memset (cache, '\0', sizeof (struct strcache2));
 }
 
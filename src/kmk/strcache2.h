@@ -32,6 +32,14 @@
 
 #define STRCACHE2_USE_MASK 1
 
+/* Caches initialized with thread_safe set can be used by several threads at
+   once.  Lookups (and adds of strings that are already there) don't take any
+   locks, only the insertion of new strings is serialized.  This is only
+   needed when includedep worker threads are around.  */
+#if defined (CONFIG_WITH_INCLUDEDEP) && !defined (CONFIG_WITHOUT_THREADS)
+# define STRCACHE2_THREAD_SAFE 1
+#endif
+
 /* string cache memory segment. */
 struct strcache2_seg
 {
@@ -86,7 +94,9 @@ struct strcache2
     unsigned int init_size;             /* The initial hash table size. */
     unsigned int hash_size;             /* The hash table size. */
     unsigned int def_seg_size;          /* The default segment size. */
-    void *lock;                         /* The lock handle. */
+    void *lock;                         /* The insert lock (thread safe caches). */
+    unsigned int volatile rehash_seq;   /* Odd while rehashing (thread safe caches). */
+    struct strcache2_entry **old_tabs;  /* Retired hash tables (thread safe caches). */
     struct strcache2_seg *seg_head;     /* The memory segment list. */
     struct strcache2 *next;             /* The next string cache. */
     const char *name;                   /* Cache name. */
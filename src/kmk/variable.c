@@ -381,6 +381,9 @@ define_variable_in_set (const char *name, unsigned int length,
 #endif
   v->length = length;
   hash_insert_at (&set->table, v, var_slot);
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+  kbuild_prop_cache_invalidate (name, length);
+#endif
 #ifdef CONFIG_WITH_VALUE_LENGTH
   if (value_len == ~0U)
     value_len = strlen (value);
@@ -485,6 +488,9 @@ undefine_variable_in_set (const char *name, unsigned int length,
          undefine it.  */
       if ((int) origin >= (int) v->origin)
 	{
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+          kbuild_prop_cache_invalidate (v->name, v->length);
+#endif
           hash_delete_at (&set->table, var_slot);
           free_variable_name_and_value (v);
 	}
@@ -897,10 +903,16 @@ initialize_file_variables (struct file *file, int reading)
 #ifndef CONFIG_WITH_STRCACHE2
       hash_init (&l->set->table, PERFILE_VARIABLE_BUCKETS,
                  variable_hash_1, variable_hash_2, variable_hash_cmp);
-#else  /* CONFIG_WITH_STRCACHE2 */
+#elif !defined (CONFIG_WITH_SMALL_VARIABLE_SETS)
       hash_init_strcached (&l->set->table, PERFILE_VARIABLE_BUCKETS,
                            &variable_strcache, offsetof (struct variable, name));
-#endif /* CONFIG_WITH_STRCACHE2 */
+#else  /* CONFIG_WITH_SMALL_VARIABLE_SETS */
+      /* Most targets have no more than a handful of variables, so start
+         out with the small table in the set and grow it when needed.  */
+      hash_init_strcached_inline (&l->set->table, VARIABLE_SET_INLINE_SLOTS,
+                                  &variable_strcache, offsetof (struct variable, name),
+                                  l->set->inline_vec, l->set->inline_ctrl);
+#endif /* CONFIG_WITH_SMALL_VARIABLE_SETS */
       file->variables = l;
     }
 
@@ -1013,10 +1025,14 @@ create_new_variable_set (void)
 #ifndef CONFIG_WITH_STRCACHE2
   hash_init (&set->table, SMALL_SCOPE_VARIABLE_BUCKETS,
 	     variable_hash_1, variable_hash_2, variable_hash_cmp);
-#else  /* CONFIG_WITH_STRCACHE2 */
+#elif !defined (CONFIG_WITH_SMALL_VARIABLE_SETS)
   hash_init_strcached (&set->table, SMALL_SCOPE_VARIABLE_BUCKETS,
                        &variable_strcache, offsetof (struct variable, name));
-#endif /* CONFIG_WITH_STRCACHE2 */
+#else  /* CONFIG_WITH_SMALL_VARIABLE_SETS */
+  hash_init_strcached_inline (&set->table, VARIABLE_SET_INLINE_SLOTS,
+                              &variable_strcache, offsetof (struct variable, name),
+                              set->inline_vec, set->inline_ctrl);
+#endif /* CONFIG_WITH_SMALL_VARIABLE_SETS */
 
 #ifndef CONFIG_WITH_ALLOC_CACHES
   setlist = (struct variable_set_list *)
@@ -1148,7 +1164,12 @@ merge_variable_sets (struct variable_set *to_set,
                                                            *from_var_slot);
 #endif /* CONFIG_WITH_STRCACHE2 */
 	if (HASH_VACANT (*to_var_slot))
-	  hash_insert_at (&to_set->table, from_var, to_var_slot);
+          {
+	    hash_insert_at (&to_set->table, from_var, to_var_slot);
+#ifdef CONFIG_WITH_KBUILD_PROP_CACHE
+            kbuild_prop_cache_invalidate (from_var->name, from_var->length);
+#endif
+          }
 	else
 	  {
 	    /* GKM FIXME: delete in from_set->table */
@@ -1362,6 +1383,11 @@ define_automatic_variables (void)
   define_variable_cname ("PATH_KBUILD_BIN", get_kbuild_bin_path (), o_default, 0);
 
   /* Define KMK_FEATURES to indicate various working KMK features. */
+# ifdef CONFIG_WITH_KBUILD_DIRECT_RULES
+#  define KMK_FEATURES_KB_SRC_ONE_3 " kb-src-one-3"
+# else
+#  define KMK_FEATURES_KB_SRC_ONE_3 ""
+# endif
 # if defined (CONFIG_WITH_RSORT) \
   && defined (CONFIG_WITH_ABSPATHEX) \
   && defined (CONFIG_WITH_TOUPPER_TOLOWER) \
@@ -1389,7 +1415,7 @@ define_automatic_variables (void)
   && defined (CONFIG_WITH_DEFINED_FUNCTIONS) \
   && defined (KMK_HELPERS)
   define_variable_cname ("KMK_FEATURES",
-                         "append-dash-n abspath includedep-queue install-hard-linking umask"
+                         "append-dash-n append-define-cmds abspath includedep-queue install-hard-linking umask"
                          " kBuild-define"
                          " rsort"
                          " abspathex"
@@ -1415,12 +1441,13 @@ define_automatic_variables (void)
                          " for while"
                          " root"
                          " length insert pos lastpos substr translate"
-                         " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl"
+                         " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl kb-col-tools"
+                         KMK_FEATURES_KB_SRC_ONE_3
                          " firstdefined lastdefined"
                          , o_default, 0);
 # else /* MSC can't deal with strings mixed with #if/#endif, thus the slow way. */
 #  error "All features should be enabled by default!"
-  strcpy (buf, "append-dash-n abspath includedep-queue install-hard-linking umask"
+  strcpy (buf, "append-dash-n append-define-cmds abspath includedep-queue install-hard-linking umask"
                " kBuild-define");
 #  if defined (CONFIG_WITH_RSORT)
   strcat (buf, " rsort");
@@ -1498,7 +1525,8 @@ define_automatic_variables (void)
   strcat (buf, " firstdefined lastdefined");
 #  endif
 #  if defined (KMK_HELPERS)
-  strcat (buf, " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl");
+  strcat (buf, " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl kb-col-tools");
+  strcat (buf, KMK_FEATURES_KB_SRC_ONE_3);
 #  endif
   define_variable_cname ("KMK_FEATURES", buf, o_default, 0);
 # endif
@@ -1507,7 +1535,7 @@ define_automatic_variables (void)
 
 #ifdef CONFIG_WITH_KMK_BUILTIN
   /* The supported kMk Builtin commands. */
-  define_variable_cname ("KMK_BUILTIN", "append cat chmod cp cmp echo expr install kDepIDB ln md5sum mkdir mv printf rm rmdir sleep test", o_default, 0);
+  define_variable_cname ("KMK_BUILTIN", "append cat chmod cp cmp echo expr install kDepIDB ln md5sum mkdir mv printf rm rmdir sed sleep test", o_default, 0);
 #endif
 
 #ifdef  __MSDOS__
@@ -112,9 +112,22 @@ struct variable
 
 /* Structure that represents a variable set.  */
 
+#ifdef CONFIG_WITH_SMALL_VARIABLE_SETS
+# ifndef CONFIG_WITH_HASH_CTRL_BYTES
+#  error "CONFIG_WITH_SMALL_VARIABLE_SETS requires CONFIG_WITH_HASH_CTRL_BYTES"
+# endif
+/* The number of slots in the table of per-target and local variable sets
+   before it needs to move to the heap.  */
+# define VARIABLE_SET_INLINE_SLOTS HASH_CTRL_GROUP
+#endif
+
 struct variable_set
   {
     struct hash_table table;	/* Hash table of variables.  */
+#ifdef CONFIG_WITH_SMALL_VARIABLE_SETS
+    void *inline_vec[VARIABLE_SET_INLINE_SLOTS];
+    unsigned char inline_ctrl[HASH_CTRL_SIZE (VARIABLE_SET_INLINE_SLOTS)];
+#endif
   };
 
 /* Structure that represents a list of variable sets.  */
@@ -34,6 +34,9 @@ struct vpath
     unsigned int patlen;/* Length of the pattern.  */
     const char **searchpath; /* Null-terminated list of directories.  */
     unsigned int maxlen;/* Maximum length of any entry in the list.  */
+#ifdef CONFIG_WITH_VPATH_INDEX
+    struct dir_index *index; /* Index of SEARCHPATH, created on demand.  */
+#endif
   };
 
 /* Linked-list of all selective VPATHs.  */
@@ -204,6 +207,10 @@ construct_vpath_list (char *pattern, char *dirpath)
 	      /* Free its unused storage.  */
               /* MSVC erroneously warns without a cast here.  */
 	      free ((void *)path->searchpath);
+#ifdef CONFIG_WITH_VPATH_INDEX
+	      if (path->index)
+	        dir_index_free (path->index);
+#endif
 	      free (path);
 	    }
 	  else
@@ -298,6 +305,9 @@ construct_vpath_list (char *pattern, char *dirpath)
       path = xmalloc (sizeof (struct vpath));
       path->searchpath = vpath;
       path->maxlen = maxvpath;
+#ifdef CONFIG_WITH_VPATH_INDEX
+      path->index = 0;
+#endif
       path->next = vpaths;
       vpaths = path;
 
@@ -348,6 +358,9 @@ selective_vpath_search (struct vpath *path, const char *file,
   unsigned int i;
   unsigned int flen, vlen, name_dplen;
   int exists = 0;
+#ifdef CONFIG_WITH_VPATH_INDEX
+  int found_in_index = -2;  /* Directory index where FILE is, -2 if unused.  */
+#endif
 
   /* Find out if *FILE is a target.
      If and only if it is NOT a target, we will accept prospective
@@ -377,6 +390,17 @@ selective_vpath_search (struct vpath *path, const char *file,
   if (name_dplen > 0)
     flen -= name_dplen + 1;
 
+#ifdef CONFIG_WITH_VPATH_INDEX
+  /* For a plain file name, ask the index which directory has it rather
+     than asking the directory cache about each directory.  */
+  if (name_dplen == 0 && n == 0)
+    {
+      if (!path->index)
+        path->index = dir_index_create (vpath);
+      found_in_index = dir_index_lookup (path->index, filename);
+    }
+#endif
+
   /* Get enough space for the biggest VPATH entry, a slash, the directory
      prefix that came with FILE, another slash (although this one may not
      always be necessary), the filename, and a null terminator.  */
@@ -463,6 +487,12 @@ selective_vpath_search (struct vpath *path, const char *file,
 
 #ifdef VMS
 	  exists_in_cache = exists = dir_file_exists_p (vpath[i], filename);
+#elif defined (CONFIG_WITH_VPATH_INDEX)
+	  *p = '\0';
+	  if (found_in_index != -2)
+	    exists_in_cache = exists = (int) i == found_in_index;
+	  else
+	    exists_in_cache = exists = dir_file_exists_p (name, filename);
 #else
 	  /* Clobber a null into the name at the last slash.
 	     Now NAME is the name of the directory to look in.  */
@@ -498,6 +528,10 @@ selective_vpath_search (struct vpath *path, const char *file,
               if (e != 0)
                 {
                   exists = 0;
+#ifdef CONFIG_WITH_VPATH_INDEX
+                  /* The cache is out of date, ask it about the rest.  */
+                  found_in_index = -2;
+#endif
                   continue;
                 }
 
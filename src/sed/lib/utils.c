@@ -35,10 +35,29 @@
 # include <stdlib.h>
 #endif /* HAVE_STDLIB_H */
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_MMAP
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# ifndef O_BINARY
+#  define O_BINARY 0
+# endif
+#endif
+
 #include "utils.h"
 
 const char *myname;
 
+#ifdef KMK_BUILTIN_SED
+jmp_buf *ck_exit_jmpbuf = NULL;
+int ck_exit_status = 0;
+#endif
+
 /* Store information about files opened with ck_fopen
    so that error messages from ck_fread, ck_fwrite, etc. can print the
    name of the file that had the error */
@@ -88,6 +107,7 @@ panic(const char *str, ...)
   /* Unlink the temporary files.  */
   while (open_files)
     {
+      struct open_file *next = open_files->link;
       if (open_files->temp)
 	{
 	  int fd = fileno (open_files->fp);
@@ -97,12 +117,61 @@ panic(const char *str, ...)
           if (errno != 0)
             fprintf (stderr, _("cannot remove %s: %s"), open_files->name, strerror (errno));
 	}
+#ifdef KMK_BUILTIN_SED
+      /* We're not exiting, so close the other files as well. */
+      else if (open_files->fp != stdin && open_files->fp != stdout
+	       && open_files->fp != stderr)
+	fclose (open_files->fp);
+      FREE (open_files->name);
+      FREE (open_files);
+#endif
+
+      open_files = next;
+    }
+
+  ck_exit(4);
+}
+
+/* Exit the program with STATUS.  When running as a kmk builtin we
+   unwind back to kmk_builtin_sed() instead. */
+void
+ck_exit(status)
+  int status;
+{
+#ifdef KMK_BUILTIN_SED
+  if (ck_exit_jmpbuf)
+    {
+      ck_exit_status = status;
+      longjmp (*ck_exit_jmpbuf, 1);
+    }
+#endif
+  exit (status);
+}
+
+#ifdef KMK_BUILTIN_SED
+/* Close whatever files an aborted command left open, without
+   panicking.  Temporary files are removed.  */
+void
+ck_cleanup()
+{
+  while (open_files)
+    {
+      struct open_file *next = open_files->link;
 
-      open_files = open_files->link;
+      if (open_files->fp != stdin && open_files->fp != stdout
+	  && open_files->fp != stderr)
+	fclose (open_files->fp);
+      if (open_files->temp)
+	unlink (open_files->name);
+      FREE (open_files->name);
+      FREE (open_files);
+      open_files = next;
     }
 
-  exit(4);
+  fflush (stdout);
+  fflush (stderr);
 }
+#endif
 
 
 /* Internal routine to get a filename from open_files */
@@ -295,8 +364,14 @@ ck_fclose(stream)
      to signal this as an error (perhaps to make). */
   if (!stream)
     {
+#ifdef KMK_BUILTIN_SED
+      /* They belong to kmk, just flush them. */
+      ck_fflush (stdout);
+      ck_fflush (stderr);
+#else
       do_ck_fclose (stdout);
       do_ck_fclose (stderr);
+#endif
     }
 }
 
@@ -341,6 +416,94 @@ ck_rename (from, to, unlink_if_fail)
   panic (_("cannot rename %s: %s"), from, strerror (errno));
 }
 
+#ifdef HAVE_MMAP
+/* Load the whole of file NAME into memory, mapping it when it is a
+   regular file and reading it into the heap otherwise (pipes, devices).
+   Returns false if the file cannot be opened, or panics if FAIL is set. */
+bool
+ck_map_file (name, mf, fail)
+  const char *name;
+  struct mapped_file *mf;
+  bool fail;
+{
+  struct stat st;
+  size_t alloc;
+  char *buf;
+  int fd;
+
+  mf->base = NULL;
+  mf->length = 0;
+  mf->mapped = false;
+
+  fd = open (name, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    {
+      if (fail)
+        panic(_("couldn't open file %s: %s"), name, strerror(errno));
+      return false;
+    }
+
+  if (fstat (fd, &st) == 0
+      && S_ISREG (st.st_mode)
+      && st.st_size > 0
+      && (off_t)(size_t)st.st_size == st.st_size)
+    {
+      VOID *pv = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (pv != MAP_FAILED)
+	{
+	  close (fd);
+	  mf->base = pv;
+	  mf->length = (size_t)st.st_size;
+	  mf->mapped = true;
+	  return true;
+	}
+    }
+
+  /* Not something we can map, read it all instead. */
+  alloc = 0;
+  buf = NULL;
+  for (;;)
+    {
+      ssize_t cb;
+
+      if (mf->length == alloc)
+	{
+	  alloc = alloc ? alloc * 2 : 8192;
+	  buf = REALLOC (buf, alloc, char);
+	}
+      cb = read (fd, buf + mf->length, alloc - mf->length);
+      if (cb > 0)
+	mf->length += cb;
+      else if (cb == 0)
+	break;
+      else if (errno != EINTR)
+	{
+	  int save_errno = errno;
+	  close (fd);
+	  FREE (buf);
+	  panic (_("read error on %s: %s"), name, strerror (save_errno));
+	}
+    }
+  close (fd);
+  mf->base = buf;
+  return true;
+}
+
+/* Release what ck_map_file gave us. */
+void
+ck_unmap_file (mf)
+  struct mapped_file *mf;
+{
+  if (mf->mapped)
+    munmap ((VOID *)mf->base, mf->length);
+  else
+    FREE ((VOID *)mf->base);
+  mf->base = NULL;
+  mf->length = 0;
+  mf->mapped = false;
+}
+#endif /* HAVE_MMAP */
+
 
 
 
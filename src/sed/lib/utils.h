@@ -20,7 +20,23 @@
 
 #include "basicdefs.h"
 
+#ifdef KMK_BUILTIN_SED
+/* kmk has its own xmalloc, don't clash with it. */
+# define xmalloc sed_xmalloc
+#endif
+
+#ifdef HAVE_MMAP
+/* A whole file loaded into memory by ck_map_file. */
+struct mapped_file
+  {
+    const char *base;
+    size_t length;
+    bool mapped;	/* true if mmap'ed, false if read into the heap */
+  };
+#endif
+
 void panic P_((const char *str, ...));
+void ck_exit P_((int status));
 
 FILE *ck_fopen P_((const char *name, const char *mode, bool fail));
 void ck_fwrite P_((const VOID *ptr, size_t size, size_t nmemb, FILE *stream));
@@ -30,6 +46,10 @@ void ck_fclose P_((FILE *stream));
 size_t ck_getline P_((char **text, size_t *buflen, FILE *stream));
 FILE * ck_mkstemp P_((char **p_filename, char *tmpdir, char *base));
 void ck_rename P_((const char *from, const char *to, const char *unlink_if_fail));
+#ifdef HAVE_MMAP
+bool ck_map_file P_((const char *name, struct mapped_file *mf, bool fail));
+void ck_unmap_file P_((struct mapped_file *mf));
+#endif
 
 VOID *ck_malloc P_((size_t size));
 VOID *xmalloc P_((size_t size));
@@ -46,3 +66,14 @@ char *add1_buffer P_((struct buffer *b, int ch));
 void free_buffer P_((struct buffer *b));
 
 extern const char *myname;
+
+#ifdef KMK_BUILTIN_SED
+# include <setjmp.h>
+
+/* Where ck_exit() unwinds to when running inside kmk; set by
+   kmk_builtin_sed() for the duration of the command. */
+extern jmp_buf *ck_exit_jmpbuf;
+extern int ck_exit_status;
+
+void ck_cleanup P_((void));
+#endif
@@ -45,6 +45,13 @@
 
 #include <obstack.h>
 
+#ifdef KMK_BUILTIN_SED
+/* Inside kmk compiled programs are released one by one (see
+   release_program), so don't put them on the obstack. */
+# undef OB_MALLOC
+# define OB_MALLOC(o,n,t) MALLOC(n,t)
+#endif
+
 
 #define YMAP_LENGTH		256 /*XXX shouldn't this be (UCHAR_MAX+1)?*/
 #define VECTOR_ALLOC_INCREMENT	40
@@ -127,9 +134,18 @@ static struct text_buf *old_text_buf = NULL;
    block end positions. */
 static struct sed_label *blocks = NULL;
 
+/* The number of -e expressions seen so far, for error messages. */
+static countT string_expr_count = 0;
+
 /* Use an obstack for compilation. */
 static struct obstack obs;
 
+#ifdef KMK_BUILTIN_SED
+/* The program compile_program is creating, so it can be released if
+   bad_prog aborts the compilation. */
+static struct vector *new_program = NULL;
+#endif
+
 /* Various error messages we may want to print */
 static const char errors[] =
   "multiple `!'s\0"
@@ -214,7 +230,7 @@ bad_prog(why)
 	    CAST(unsigned long)cur_input.string_expr_count,
 	    CAST(unsigned long)(prog.cur-prog.base),
 	    why);
-  exit(EXIT_FAILURE);
+  ck_exit(EXIT_FAILURE);
 }
 
 
@@ -448,6 +464,10 @@ next_cmd_entry(vectorp)
   cmd->range_state = RANGE_INACTIVE;
   cmd->addr_bang = false;
   cmd->cmd = '\0';	/* something invalid, to catch bugs early */
+#ifdef KMK_BUILTIN_SED
+  /* release_program may see this if compilation is aborted. */
+  memset(&cmd->x, 0, sizeof(cmd->x));
+#endif
 
   *vectorp  = v;
   return cmd;
@@ -741,9 +761,10 @@ release_label(list_head)
 
   FREE(list_head->name);
 
-#if 0
-  /* We use obstacks */
+#ifdef KMK_BUILTIN_SED
   FREE(list_head);
+#else
+  /* We use obstacks */
 #endif
   return ret;
 }
@@ -784,6 +805,9 @@ setup_replacement(sub, text, length)
   sub->max_id = 0;
   base = MEMDUP(text, length, char);
   length = normalize_text(base, length, TEXT_REPLACEMENT);
+#ifdef KMK_BUILTIN_SED
+  sub->replacement_text = base;
+#endif
 
   text_end = base + length;
   tail = &root;
@@ -1034,7 +1058,11 @@ compile_program(vector)
       vector->v_allocated = 0;
       vector->v_length = 0;
 
+#ifdef KMK_BUILTIN_SED
+      new_program = vector;
+#else
       obstack_init (&obs);
+#endif
     }
   if (pending_text)
     read_text(NULL, '\n');
@@ -1150,6 +1178,7 @@ compile_program(vector)
 	  ch = in_nonblank();
 	  if (ch == EOF || ch == '\n')
 	    {
+	      cur_cmd->x.cmd_txt.text = NULL;
 	      cur_cmd->x.cmd_txt.text_length = 0;
 	      break;
 	    }
@@ -1386,6 +1415,9 @@ compile_program(vector)
       /* this is buried down here so that "continue" statements will miss it */
       ++vector->v_length;
     }
+#ifdef KMK_BUILTIN_SED
+  new_program = NULL;
+#endif
   return vector;
 }
 
@@ -1556,7 +1588,6 @@ compile_string(cur_program, str, len)
   char *str;
   size_t len;
 {
-  static countT string_expr_count = 0;
   struct vector *ret;
 
   prog.file = NULL;
@@ -1587,16 +1618,40 @@ compile_file(cur_program, cmdfile)
 {
   size_t len;
   struct vector *ret;
+#ifdef HAVE_MMAP
+  struct mapped_file mf;
+#endif
 
   prog.file = stdin;
   if (cmdfile[0] != '-' || cmdfile[1] != '\0')
-    prog.file = ck_fopen(cmdfile, "rt", true);
+    {
+#ifdef HAVE_MMAP
+      /* Compile it straight out of memory instead of going thru stdio. */
+      ck_map_file(cmdfile, &mf, true);
+      prog.file = NULL;
+      prog.base = CAST(unsigned char *)mf.base;
+      prog.cur = prog.base;
+      prog.end = prog.cur + mf.length;
+#else
+      prog.file = ck_fopen(cmdfile, "rt", true);
+#endif
+    }
 
   cur_input.line = 1;
   cur_input.name = cmdfile;
   cur_input.string_expr_count = 0;
 
   ret = compile_program(cur_program);
+#ifdef HAVE_MMAP
+  if (!prog.file)
+    {
+      ck_unmap_file(&mf);
+      prog.base = NULL;
+      prog.cur = NULL;
+      prog.end = NULL;
+    }
+  else
+#endif
   if (prog.file != stdin)
     ck_fclose(prog.file);
   prog.file = NULL;
@@ -1675,6 +1730,150 @@ check_final_program(program)
   }
 }
 
+#ifdef KMK_BUILTIN_SED
+/* Can the compiled program be run again by a later kmk_builtin_sed
+   invocation?  Not if it has files opened at compile time (w, W, R
+   and s///w), since those must be reopened for every run. */
+bool
+reusable_program(program)
+  struct vector *program;
+{
+  struct sed_cmd *cur_cmd;
+  size_t n;
+
+  for (cur_cmd = program->v, n = program->v_length; n--; cur_cmd++)
+    switch (cur_cmd->cmd)
+      {
+      case 'w':
+      case 'W':
+      case 'R':
+	return false;
+      case 's':
+	if (cur_cmd->x.cmd_subst->outf)
+	  return false;
+	break;
+      }
+  return true;
+}
+
+/* Free a program compiled by compile_string and compile_file, once
+   finish_program has closed its files. */
+void
+release_program(program)
+  struct vector *program;
+{
+  struct sed_cmd *cur_cmd;
+  size_t n;
+
+  for (cur_cmd = program->v, n = program->v_length; n--; cur_cmd++)
+    {
+      if (cur_cmd->a1)
+	{
+	  if (cur_cmd->a1->addr_regex)
+	    release_regex(cur_cmd->a1->addr_regex);
+	  FREE(cur_cmd->a1);
+	}
+      if (cur_cmd->a2)
+	{
+	  if (cur_cmd->a2->addr_regex)
+	    release_regex(cur_cmd->a2->addr_regex);
+	  FREE(cur_cmd->a2);
+	}
+
+      switch (cur_cmd->cmd)
+	{
+	case 'a':
+	case 'i':
+	case 'c':
+	case 'e':
+	  FREE(cur_cmd->x.cmd_txt.text);
+	  break;
+
+	case 'r':
+	  FREE(cur_cmd->x.fname);
+	  break;
+
+	case 's':
+	  {
+	    struct subst *sub = cur_cmd->x.cmd_subst;
+	    struct replacement *p, *q;
+
+	    if (sub->regx)
+	      release_regex(sub->regx);
+	    for (p = sub->replacement; p; p = q)
+	      {
+		q = p->next;
+		FREE(p);
+	      }
+	    FREE(sub->replacement_text);
+	    FREE(sub);
+	  }
+	  break;
+
+	case 'y':
+	  if (mb_cur_max > 1)
+	    {
+	      char **trans = cur_cmd->x.translatemb;
+	      int i;
+
+	      for (i = 0; trans[i]; i++)
+		FREE(trans[i]);
+	      FREE(trans);
+	    }
+	  else
+	    FREE(cur_cmd->x.translate);
+	  break;
+	}
+    }
+
+  FREE(program->v);
+  FREE(program);
+}
+
+/* Forget about any half compiled program, getting ready for the next
+   kmk_builtin_sed invocation.  The files were closed by ck_cleanup. */
+void
+reset_compiler()
+{
+  struct output *p, *q;
+
+  while (jumps)
+    jumps = release_label(jumps);
+  while (labels)
+    labels = release_label(labels);
+  while (blocks)
+    blocks = release_label(blocks);
+  if (pending_text)
+    free_buffer(pending_text);
+  pending_text = NULL;
+  old_text_buf = NULL;
+  for (p = file_read; p; p = q)
+    {
+      q = p->link;
+      FREE(p->name);
+      FREE(p);
+    }
+  for (p = file_write; p; p = q)
+    {
+      q = p->link;
+      FREE(p->name);
+      FREE(p);
+    }
+  file_read = file_write = NULL;
+  if (new_program)
+    release_program(new_program);
+  new_program = NULL;
+
+  prog.file = NULL;
+  prog.base = NULL;
+  prog.cur = NULL;
+  prog.end = NULL;
+  memset(&cur_input, 0, sizeof(cur_input));
+  first_script = true;
+  string_expr_count = 0;
+}
+#endif /* KMK_BUILTIN_SED */
+
 /* Rewind all resources which were allocated in this module. */
 void
 rewind_read_files()
@@ -1700,9 +1899,10 @@ finish_program(program)
 	if (p->fp)
 	  ck_fclose(p->fp);
 	q = p->link;
-#if 0
-	/* We use obstacks. */
+#ifdef KMK_BUILTIN_SED
 	FREE(p);
+#else
+	/* We use obstacks. */
 #endif
       }
 
@@ -1711,9 +1911,10 @@ finish_program(program)
 	if (p->fp)
 	  ck_fclose(p->fp);
 	q = p->link;
-#if 0
-	/* We use obstacks. */
+#ifdef KMK_BUILTIN_SED
 	FREE(p);
+#else
+	/* We use obstacks. */
 #endif
       }
     file_read = file_write = NULL;
@@ -19,6 +19,7 @@
 #undef EXPERIMENTAL_DASH_N_OPTIMIZATION	/*don't use -- is very buggy*/
 #define INITIAL_BUFFER_SIZE	50
 #define FREAD_BUFFER_SIZE	8192
+#define OUTPUT_BUFFER_SIZE	65536
 
 #include "sed.h"
 
@@ -70,6 +71,9 @@ extern int errno;
 #endif
 
 #include <sys/stat.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 
 /* Sed operates a line at a time. */
@@ -150,6 +154,20 @@ static struct line buffer;
 static struct append_queue *append_head = NULL;
 static struct append_queue *append_tail = NULL;
 
+#ifdef HAVE_MMAP
+/* The current input file, if it is a regular file that could be mapped
+   into memory.  read_mapped_line takes the lines straight out of it. */
+static struct {
+  char *base;
+  size_t size;
+  const char *cur;
+} input_map;
+#endif
+
+/* Big stdio buffers for the in-place output file and for sed_stdout. */
+static char *in_place_buffer = NULL;
+static char *stdout_buffer = NULL;
+
 
 #ifdef BOOTSTRAP
 /* We can't be sure that the system we're boostrapping on has
@@ -481,6 +499,91 @@ read_file_line(input)
   return true;
 }
 
+#ifdef HAVE_MMAP
+static bool read_mapped_line P_((struct input *));
+static bool
+read_mapped_line(input)
+  struct input *input UNUSED;
+{
+  const char *start = input_map.cur;
+  const char *end = input_map.base + input_map.size;
+  const char *nl;
+
+  if (start >= end)
+    return false;
+
+  nl = memchr(start, '\n', end - start);
+  if (nl)
+    input_map.cur = nl + 1;
+  else
+    {
+      nl = end;
+      input_map.cur = end;
+      line.chomped = false;
+    }
+
+  str_append(&line, start, nl - start);
+  return true;
+}
+
+/* Map the input file into memory if it's a regular file, so we don't
+   have to go thru stdio and getline for every line. */
+static void map_input_file P_((struct input *));
+static void
+map_input_file(input)
+  struct input *input;
+{
+  struct stat st;
+  VOID *pv;
+
+  if (fstat(fileno(input->fp), &st) != 0
+      || !S_ISREG(st.st_mode)
+      || st.st_size <= 0
+      || (off_t)(size_t)st.st_size != st.st_size)
+    return;
+
+  pv = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+	    fileno(input->fp), 0);
+  if (pv == MAP_FAILED)
+    return;
+# ifdef MADV_SEQUENTIAL
+  madvise(pv, (size_t)st.st_size, MADV_SEQUENTIAL);
+# endif
+
+  input_map.base = pv;
+  input_map.size = (size_t)st.st_size;
+  input_map.cur = input_map.base;
+  input->read_fn = read_mapped_line;
+}
+
+static void unmap_input_file P_((void));
+static void
+unmap_input_file()
+{
+  if (input_map.base)
+    munmap(input_map.base, input_map.size);
+  input_map.base = NULL;
+  input_map.size = 0;
+  input_map.cur = NULL;
+}
+#endif /* HAVE_MMAP */
+
+/* Give FP a big buffer, unless it's a terminal or -u was given.  Must be
+   called before anything is written to FP.  *BUF is allocated on first
+   use and must not be freed while FP is open. */
+static void set_output_buffer P_((FILE *, char **));
+static void
+set_output_buffer(fp, buf)
+  FILE *fp;
+  char **buf;
+{
+  if (unbuffered_output || isatty(fileno(fp)))
+    return;
+  if (!*buf)
+    *buf = MALLOC(OUTPUT_BUFFER_SIZE, char);
+  setvbuf(fp, *buf, _IOFBF, OUTPUT_BUFFER_SIZE);
+}
+
 
 static inline void output_missing_newline P_((struct output *));
 static inline void
@@ -499,11 +602,8 @@ static inline void
 flush_output(fp)
   FILE *fp;
 {
-#ifndef CONFIG_WITHOUT_O_OPT
-  if (fp != sed_stdout || unbuffered_output)
-#else
-  if (fp != stdout || unbuffered_output)
-#endif
+  /* The w files are flushed for every line, the output file is not. */
+  if (fp != output_file.fp || unbuffered_output)
     ck_fflush(fp);
 }
 
@@ -578,6 +678,19 @@ dump_append_queue()
 
       if (p->fname)
 	{
+#ifdef HAVE_MMAP
+	  struct mapped_file mf;
+
+	  /* "If _fname_ does not exist or cannot be read, it shall
+	     be treated as if it were an empty file, causing no error
+	     condition."  IEEE Std 1003.2-1992
+	     So, don't fail. */
+	  if (ck_map_file(p->fname, &mf, false))
+	    {
+	      ck_fwrite(mf.base, 1, mf.length, output_file.fp);
+	      ck_unmap_file(&mf);
+	    }
+#else
 	  char buf[FREAD_BUFFER_SIZE];
 	  size_t cnt;
 	  FILE *fp;
@@ -593,6 +706,7 @@ dump_append_queue()
 		ck_fwrite(buf, 1, cnt, output_file.fp);
 	      ck_fclose(fp);
 	    }
+#endif
 	}
     }
 
@@ -658,6 +772,10 @@ open_next_file(name, input)
     }
 
   input->read_fn = read_file_line;
+#ifdef HAVE_MMAP
+  if (input->fp != stdin)
+    map_input_file(input);
+#endif
 
   if (in_place_extension)
     {
@@ -686,6 +804,7 @@ open_next_file(name, input)
 
       if (!output_file.fp)
         panic(_("couldn't open temporary file %s: %s"), input->out_file_name, strerror(errno));
+      set_output_buffer (output_file.fp, &in_place_buffer);
 
       output_fd = fileno (output_file.fp);
 #ifdef HAVE_FCHMOD
@@ -714,6 +833,9 @@ closedown(input)
   input->read_fn = read_always_fail;
   if (!input->fp)
     return;
+#ifdef HAVE_MMAP
+  unmap_input_file();
+#endif
   if (input->fp != stdin) /* stdin can be reused on tty and tape devices */
     ck_fclose(input->fp);
 
@@ -811,6 +933,10 @@ last_file_with_data_p(input)
       if (!*input->file_list)
 	return true;
       open_next_file(*input->file_list++, input);
+#ifdef HAVE_MMAP
+      if (input_map.base)
+	return false;		/* mapped files are never empty */
+#endif
       if (input->fp)
 	{
 	  if ((ch = getc(input->fp)) != EOF)
@@ -832,6 +958,12 @@ test_eof(input)
 
   if (buffer.length)
     return false;
+#ifdef HAVE_MMAP
+  if (input_map.base)
+    return input_map.cur < input_map.base + input_map.size
+	   ? false
+	   : separate_files || last_file_with_data_p(input);
+#endif
   if (!input->fp)
     return separate_files || last_file_with_data_p(input);
   if (feof(input->fp))
@@ -1697,6 +1829,28 @@ execute_program(vec, input)
 
 
 
+#ifdef KMK_BUILTIN_SED
+/* Release the per-command state, whether process_files completed or
+   was aborted by panic().  The s command's accumulator is kept. */
+void
+reset_executor()
+{
+#ifdef HAVE_MMAP
+  unmap_input_file();
+#endif
+  release_append_queue();
+  FREE(buffer.text);
+  FREE(hold.text);
+  FREE(line.text);
+  memset(&buffer, 0, sizeof(buffer));
+  memset(&hold, 0, sizeof(hold));
+  memset(&line, 0, sizeof(line));
+  output_file.fp = NULL;
+  output_file.missing_newline = false;
+  replaced = false;
+}
+#endif
+
 /* Apply the compiled script to all the named files. */
 int
 process_files(the_program, argv)
@@ -1728,6 +1882,16 @@ process_files(the_program, argv)
   input.read_fn = read_always_fail;
   input.fp = NULL;
 
+  /* Only touch kmk's stdout buffering when running standalone. */
+#ifndef CONFIG_WITHOUT_O_OPT
+# ifdef KMK_BUILTIN_SED
+  if (sed_stdout != stdout)
+# endif
+    set_output_buffer (sed_stdout, &stdout_buffer);
+#elif !defined(KMK_BUILTIN_SED)
+  set_output_buffer (stdout, &stdout_buffer);
+#endif
+
   status = EXIT_SUCCESS;
   while (read_pattern_space(&input, the_program, false))
     {
@@ -1739,7 +1903,10 @@ process_files(the_program, argv)
     }
   closedown(&input);
 
-#ifdef DEBUG_LEAKS
+#ifdef KMK_BUILTIN_SED
+  /* We're not about to exit, so clean up for the next command. */
+  reset_executor();
+#elif defined(DEBUG_LEAKS)
   /* We're about to exit, so these free()s are redundant.
      But if we're running under a memory-leak detecting
      implementation of malloc(), we want to explicitly
@@ -17,8 +17,13 @@
 
 #include "sed.h"
 #include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_LANGINFO_CODESET
+# include <langinfo.h>
+#endif
 
 int mb_cur_max;
+bool is_utf8;
 
 #ifdef HAVE_MBRTOWC
 /* Add a byte to the multibyte character represented by the state
@@ -52,5 +57,16 @@ initialize_mbcs ()
 #else
   mb_cur_max = 1;
 #endif
+
+  is_utf8 = false;
+#ifdef HAVE_LANGINFO_CODESET
+  if (mb_cur_max > 1)
+    {
+      const char *codeset = nl_langinfo (CODESET);
+      is_utf8 = codeset
+		&& (strcmp (codeset, "UTF-8") == 0
+		    || strcmp (codeset, "utf8") == 0);
+    }
+#endif
 }
 
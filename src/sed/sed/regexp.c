@@ -22,6 +22,11 @@
 #ifdef HAVE_STDLIB_H
 # include <stdlib.h>
 #endif
+#ifdef HAVE_STRINGS_H
+# include <strings.h>
+#else
+# include <string.h>
+#endif /*HAVE_STRINGS_H*/
 
 #ifdef gettext_noop
 # define N_(String) gettext_noop(String)
@@ -118,6 +123,132 @@ compile_regex_1 (new_regex, needed_sub)
     }
 }
 
+#ifndef REG_PERL
+/* Check whether the regexp in NEW_REGEX is a plain string, possibly
+   anchored with ^ and $, and if so set it up for match_literal.
+   Most sed scripts in build systems look for such strings only. */
+static void
+compile_literal (new_regex)
+  struct regex *new_regex;
+{
+  const char *p = new_regex->re;
+  const char *end = p + new_regex->sz;
+  bool ere = (extended_regexp_flags & REG_EXTENDED) != 0;
+  const char *ere_specials = "+?{}()|";
+  char *lit;
+  size_t len = 0;
+
+  new_regex->literal = NULL;
+
+  /* Case folding and newline anchors need the real thing, and so do
+     multibyte character sets other than UTF-8, where an ASCII byte
+     can be part of a character. */
+  if (new_regex->flags & (REG_ICASE | REG_NEWLINE))
+    return;
+  if (mb_cur_max > 1 && !is_utf8)
+    return;
+
+  new_regex->literal_bol = p < end && *p == '^';
+  if (new_regex->literal_bol)
+    p++;
+  new_regex->literal_eol = false;
+
+  lit = MALLOC (end - p + 1, char);
+  while (p < end)
+    {
+      unsigned char ch = *p++;
+
+      switch (ch)
+	{
+	case '\\':
+	  if (p == end)
+	    goto not_literal;
+	  ch = *p++;
+	  if (!strchr (".*[]\\^$", ch) && !(ere && strchr (ere_specials, ch)))
+	    goto not_literal;	/* \(, \{, \1, \w, \< and friends */
+	  break;
+
+	case '$':
+	  if (p != end)
+	    goto not_literal;
+	  new_regex->literal_eol = true;
+	  continue;
+
+	case '.':
+	case '*':
+	case '[':
+	case '^':
+	  goto not_literal;
+
+	default:
+	  if (ere && strchr (ere_specials, ch))
+	    goto not_literal;
+	  break;
+	}
+
+      /* In UTF-8 only ASCII bytes are guaranteed to be whole characters. */
+      if (ch >= 0x80 && mb_cur_max > 1)
+	goto not_literal;
+      lit[len++] = ch;
+    }
+  if (len == 0 && !new_regex->literal_bol && !new_regex->literal_eol)
+    goto not_literal;
+
+  new_regex->literal = lit;
+  new_regex->literal_len = len;
+  return;
+
+ not_literal:
+  FREE (lit);
+}
+
+/* Find the string of REGEX in BUF, starting at BUF_START_OFFSET, the way
+   re_search would.  Returns the offset of the match or -1. */
+static regoff_t
+match_literal (regex, buf, buflen, buf_start_offset)
+  struct regex *regex;
+  const char *buf;
+  size_t buflen;
+  size_t buf_start_offset;
+{
+  const char *lit = regex->literal;
+  size_t len = regex->literal_len;
+  const char *p;
+  const char *last;
+
+  if (buflen - buf_start_offset < len)
+    return -1;
+
+  if (regex->literal_bol)
+    {
+      if (buf_start_offset != 0
+	  || (regex->literal_eol && buflen != len)
+	  || memcmp (buf, lit, len) != 0)
+	return -1;
+      return 0;
+    }
+
+  if (regex->literal_eol)
+    {
+      if (memcmp (buf + buflen - len, lit, len) != 0)
+	return -1;
+      return buflen - len;
+    }
+
+  /* Let memchr find candidates for the first character. */
+  p = buf + buf_start_offset;
+  last = buf + buflen - len;
+  while (p <= last
+	 && (p = memchr (p, (unsigned char)*lit, last - p + 1)) != NULL)
+    {
+      if (memcmp (p + 1, lit + 1, len - 1) == 0)
+	return p - buf;
+      p++;
+    }
+  return -1;
+}
+#endif /* !REG_PERL */
+
 struct regex *
 compile_regex(b, flags, needed_sub)
   struct buffer *b;
@@ -148,6 +279,9 @@ compile_regex(b, flags, needed_sub)
 #endif
 
   compile_regex_1 (new_regex, needed_sub);
+#ifndef REG_PERL
+  compile_literal (new_regex);
+#endif
   return new_regex;
 }
 
@@ -189,6 +323,9 @@ copy_regs (regs, pmatch, nregs)
 }
 #endif
 
+/* The last regexp matched, used for the empty regexp. */
+static struct regex *regex_last;
+
 int
 match_regex(regex, buf, buflen, buf_start_offset, regarray, regsize)
   struct regex *regex;
@@ -199,7 +336,6 @@ match_regex(regex, buf, buflen, buf_start_offset, regarray, regsize)
   int regsize;
 {
   int ret;
-  static struct regex *regex_last;
 #ifdef REG_PERL
   regmatch_t rm[10], *regmatch = rm;
   if (regsize > 10)
@@ -228,6 +364,29 @@ match_regex(regex, buf, buflen, buf_start_offset, regarray, regsize)
 
   return (ret == 0);
 #else
+  if (regex->literal)
+    {
+      regoff_t start = match_literal (regex, buf, buflen, buf_start_offset);
+      if (start < 0)
+	return false;
+      if (regsize)
+	{
+	  int i;
+
+	  if (regarray->num_regs < CAST(unsigned)regsize)
+	    {
+	      regarray->start = REALLOC (regarray->start, regsize, regoff_t);
+	      regarray->end = REALLOC (regarray->end, regsize, regoff_t);
+	      regarray->num_regs = regsize;
+	    }
+	  regarray->start[0] = start;
+	  regarray->end[0] = start + regex->literal_len;
+	  for (i = 1; i < regsize; i++)
+	    regarray->start[i] = regarray->end[i] = -1;
+	}
+      return true;
+    }
+
   if (regex->pattern.no_sub && regsize)
     compile_regex_1 (regex, regsize);
 
@@ -242,12 +401,26 @@ match_regex(regex, buf, buflen, buf_start_offset, regarray, regsize)
 }
 
 
-#ifdef DEBUG_LEAKS
+#if defined(DEBUG_LEAKS) || defined(KMK_BUILTIN_SED)
 void
 release_regex(regex)
   struct regex *regex;
 {
+  if (regex_last == regex)
+    regex_last = NULL;
+#ifndef REG_PERL
+  FREE(regex->literal);
+#endif
   regfree(&regex->pattern);
   FREE(regex);
 }
-#endif /*DEBUG_LEAKS*/
+#endif /*DEBUG_LEAKS || KMK_BUILTIN_SED*/
+
+#ifdef KMK_BUILTIN_SED
+/* Don't let the empty regexp of the next command pick up one of ours. */
+void
+forget_last_regex()
+{
+  regex_last = NULL;
+}
+#endif
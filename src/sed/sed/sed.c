@@ -88,6 +88,245 @@ countT lcmd_out_line_len = 70;
 /* The complete compiled SED program that we are going to run: */
 static struct vector *the_program = NULL;
 
+#ifdef KMK_BUILTIN_SED
+/* A script given by -e or -f (or as the first argument).  These are
+   collected while parsing the options, so that the compiled program
+   can be looked up in the script cache before compiling anything. */
+struct script_piece {
+  char type;			/* 'e' or 'f' */
+  char *arg;			/* the script text or script file name */
+  int extended_regexp_flags;	/* -r / -R in effect for this script */
+  bool posix;			/* --posix given before this script */
+};
+
+static struct script_piece *script_pieces = NULL;
+static size_t script_piece_count = 0;
+static size_t script_piece_alloc = 0;
+
+/* --posix was given. */
+static bool posix_option = false;
+
+/* The scripts of this invocation may be cached (no --lang_c). */
+static bool script_cacheable = true;
+
+/* Programs compiled by earlier invocations, most recently used first.
+   The key is the text of all the scripts along with the options and
+   settings affecting their compilation. */
+struct script_cache_entry {
+  struct script_cache_entry *next;
+  unsigned hash;
+  size_t key_length;
+  char *key;
+  struct vector *program;
+  bool no_default_output;	/* the script started with #n */
+  enum posixicity_types posixicity; /* after compiling (the v command) */
+};
+
+#define SCRIPT_CACHE_MAX_ENTRIES 64
+static struct script_cache_entry *script_cache = NULL;
+
+/* The cache key of the current invocation, NULL if not cacheable. */
+static struct buffer *script_key = NULL;
+
+/* Whether the current scripts started with #n. */
+static bool script_no_default_output = false;
+
+/* The cache entry the_program came from, if any. */
+static struct script_cache_entry *cached_program = NULL;
+
+/* The locale kmk was using before --lang_c changed it. */
+static char *saved_locale = NULL;
+
+static void add_script_piece P_((int type, char *arg));
+static void
+add_script_piece(type, arg)
+  int type;
+  char *arg;
+{
+  struct script_piece *piece;
+
+  if (script_piece_count == script_piece_alloc)
+    {
+      script_piece_alloc = script_piece_alloc ? script_piece_alloc * 2 : 8;
+      script_pieces = REALLOC(script_pieces, script_piece_alloc,
+			      struct script_piece);
+    }
+  piece = &script_pieces[script_piece_count++];
+  piece->type = type;
+  piece->arg = arg;
+  piece->extended_regexp_flags = extended_regexp_flags;
+  piece->posix = posix_option;
+}
+
+static unsigned hash_script_key P_((const char *key, size_t len));
+static unsigned
+hash_script_key(key, len)
+  const char *key;
+  size_t len;
+{
+  unsigned hash = 0;
+  while (len-- > 0)
+    hash = *(const unsigned char *)key++ + (hash << 6) + (hash << 16) - hash;
+  return hash;
+}
+
+/* Build the cache key for the collected scripts.  Returns NULL if one
+   of them cannot be cached (a script read from stdin). */
+static struct buffer *make_script_key P_((void));
+static struct buffer *
+make_script_key()
+{
+  struct buffer *key = init_buffer();
+  size_t i;
+
+  add_buffer(key, CAST(char *)&posixicity, sizeof(posixicity));
+  add_buffer(key, CAST(char *)&mb_cur_max, sizeof(mb_cur_max));
+  add1_buffer(key, posix_option);
+  for (i = 0; i < script_piece_count; i++)
+    {
+      struct script_piece *piece = &script_pieces[i];
+      size_t len;
+
+      add1_buffer(key, piece->type);
+      add1_buffer(key, piece->posix);
+      add_buffer(key, CAST(char *)&piece->extended_regexp_flags,
+		 sizeof(piece->extended_regexp_flags));
+      if (piece->type == 'e')
+	{
+	  len = strlen(piece->arg);
+	  add_buffer(key, CAST(char *)&len, sizeof(len));
+	  add_buffer(key, piece->arg, len);
+	}
+#ifdef HAVE_MMAP
+      else if (piece->arg[0] != '-' || piece->arg[1] != '\0')
+	{
+	  /* Key on the content so an edited script file is recompiled. */
+	  struct mapped_file mf;
+
+	  ck_map_file(piece->arg, &mf, true);
+	  add_buffer(key, CAST(char *)&mf.length, sizeof(mf.length));
+	  add_buffer(key, CAST(char *)mf.base, mf.length);
+	  ck_unmap_file(&mf);
+	}
+#endif
+      else
+	{
+	  free_buffer(key);
+	  return NULL;
+	}
+    }
+  return key;
+}
+
+/* Compile the scripts collected so far and append them to PROGRAM,
+   unless an earlier invocation has already compiled the same thing. */
+static struct vector *compile_script_pieces P_((struct vector *program));
+static struct vector *
+compile_script_pieces(program)
+  struct vector *program;
+{
+  bool saved_no_default_output = no_default_output;
+  int saved_extended_regexp_flags = extended_regexp_flags;
+  size_t i;
+
+  if (script_cacheable && !program && script_piece_count)
+    script_key = make_script_key();
+  if (script_key)
+    {
+      unsigned hash = hash_script_key(get_buffer(script_key),
+				      size_buffer(script_key));
+      struct script_cache_entry *prev = NULL;
+      struct script_cache_entry *entry;
+
+      for (entry = script_cache; entry; prev = entry, entry = entry->next)
+	if (entry->hash == hash
+	    && entry->key_length == size_buffer(script_key)
+	    && !memcmp(entry->key, get_buffer(script_key), entry->key_length))
+	  {
+	    if (prev)
+	      {
+		prev->next = entry->next;
+		entry->next = script_cache;
+		script_cache = entry;
+	      }
+	    if (entry->no_default_output)
+	      no_default_output = true;
+	    posixicity = entry->posixicity;
+	    free_buffer(script_key);
+	    script_key = NULL;
+	    script_piece_count = 0;
+	    cached_program = entry;
+	    return entry->program;
+	  }
+    }
+
+  /* Compile them, replaying the options that were given in between. */
+  no_default_output = false;
+  for (i = 0; i < script_piece_count; i++)
+    {
+      struct script_piece *piece = &script_pieces[i];
+
+      extended_regexp_flags = piece->extended_regexp_flags;
+      if (piece->posix && (i == 0 || !script_pieces[i - 1].posix))
+	posixicity = POSIXLY_BASIC;
+      if (piece->type == 'e')
+	program = compile_string(program, piece->arg, strlen(piece->arg));
+      else
+	program = compile_file(program, piece->arg);
+    }
+  if (posix_option
+      && (!script_piece_count || !script_pieces[script_piece_count - 1].posix))
+    posixicity = POSIXLY_BASIC;
+  extended_regexp_flags = saved_extended_regexp_flags;
+  script_piece_count = 0;
+
+  script_no_default_output = no_default_output;
+  no_default_output = saved_no_default_output || no_default_output;
+  return program;
+}
+
+/* Add the freshly compiled PROGRAM to the script cache if possible. */
+static void remember_program P_((struct vector *program));
+static void
+remember_program(program)
+  struct vector *program;
+{
+  struct script_cache_entry *entry;
+  struct script_cache_entry **pp;
+  unsigned n;
+
+  if (!script_key)
+    return;
+  if (reusable_program(program))
+    {
+      entry = MALLOC(1, struct script_cache_entry);
+      entry->key_length = size_buffer(script_key);
+      entry->key = MEMDUP(get_buffer(script_key), entry->key_length, char);
+      entry->hash = hash_script_key(entry->key, entry->key_length);
+      entry->program = program;
+      entry->no_default_output = script_no_default_output;
+      entry->posixicity = posixicity;
+      entry->next = script_cache;
+      script_cache = entry;
+      cached_program = entry;
+
+      /* Evict the least recently used one. */
+      for (pp = &script_cache, n = 0; *pp; pp = &(*pp)->next)
+	if (++n > SCRIPT_CACHE_MAX_ENTRIES)
+	  {
+	    entry = *pp;
+	    *pp = NULL;
+	    release_program(entry->program);
+	    FREE(entry->key);
+	    FREE(entry);
+	    break;
+	  }
+    }
+  free_buffer(script_key);
+  script_key = NULL;
+}
+#endif /* KMK_BUILTIN_SED */
+
 static void usage P_((int));
 static void
 usage(status)
@@ -149,11 +388,17 @@ Be sure to include the word ``%s'' somewhere in the ``Subject:'' field.\n"),
 	  BUG_ADDRESS, PACKAGE);
 
   ck_fclose (NULL);
-  exit (status);
+  ck_exit (status);
 }
 
+#ifdef KMK_BUILTIN_SED
+static int sed_main P_((int, char **));
+static int
+sed_main(argc, argv)
+#else
 int
 main(argc, argv)
+#endif
   int argc;
   char **argv;
 {
@@ -209,7 +454,25 @@ main(argc, argv)
 #ifndef CONFIG_WITHOUT_O_OPT
   sed_stdout = stdout;
 #endif
-#if HAVE_SETLOCALE
+#ifdef KMK_BUILTIN_SED
+  /* Reset the option state left behind by the previous invocation.
+     The locale is kmk's business and left alone. */
+  extended_regexp_flags = 0;
+  unbuffered_output = false;
+  no_default_output = false;
+  separate_files = false;
+  in_place_extension = NULL;
+  lcmd_out_line_len = 70;
+  the_program = NULL;
+  cached_program = NULL;
+  script_piece_count = 0;
+  posix_option = false;
+  script_cacheable = true;
+  opterr = 1;
+  optarg = NULL;
+  optopt = 0;
+  optind = 0;
+#elif HAVE_SETLOCALE
   /* Set locale according to user's wishes.  */
 #ifdef _MSC_VER
   {
@@ -268,10 +531,18 @@ main(argc, argv)
 	  no_default_output = true;
 	  break;
 	case 'e':
+#ifdef KMK_BUILTIN_SED
+	  add_script_piece('e', optarg);
+#else
 	  the_program = compile_string(the_program, optarg, strlen(optarg));
+#endif
 	  break;
 	case 'f':
+#ifdef KMK_BUILTIN_SED
+	  add_script_piece('f', optarg);
+#else
 	  the_program = compile_file(the_program, optarg);
+#endif
 	  break;
 
 	case 'i':
@@ -298,6 +569,16 @@ main(argc, argv)
 
 #ifndef CONFIG_WITHOUT_O_LANG_C
 	case 'L':
+# ifdef KMK_BUILTIN_SED
+	  /* The scripts given so far are compiled for the current locale. */
+	  script_cacheable = false;
+	  the_program = compile_script_pieces(the_program);
+	  if (!saved_locale)
+	    {
+	      const char *cur_locale = setlocale (LC_ALL, NULL);
+	      saved_locale = ck_strdup (cur_locale ? cur_locale : "C");
+	    }
+# endif
 	  setlocale (LC_ALL, "C");
 	  initialize_mbcs ();
 # if ENABLE_NLS
@@ -334,7 +615,11 @@ main(argc, argv)
 #endif
 
 	case 'p':
+#ifdef KMK_BUILTIN_SED
+	  posix_option = true;
+#else
 	  posixicity = POSIXLY_BASIC;
+#endif
 	  break;
 
 	case 'r':
@@ -379,7 +664,7 @@ to the extent permitted by law.\n\
 "), COPYRIGHT_NOTICE);
 
 	  ck_fclose (NULL);
-	  exit (0);
+	  ck_exit (0);
 	case 'h':
 	  usage(0);
 	default:
@@ -387,6 +672,11 @@ to the extent permitted by law.\n\
 	}
     }
 
+#ifdef KMK_BUILTIN_SED
+  if (!the_program && !script_piece_count && optind < argc)
+    add_script_piece('e', argv[optind++]);
+  the_program = compile_script_pieces(the_program);
+#endif
   if (!the_program)
     {
       if (optind < argc)
@@ -398,6 +688,10 @@ to the extent permitted by law.\n\
 	usage(4);
     }
   check_final_program(the_program);
+#ifdef KMK_BUILTIN_SED
+  if (!cached_program)
+    remember_program(the_program);
+#endif
 
   return_code = process_files(the_program, argv+optind);
 
@@ -406,3 +700,55 @@ to the extent permitted by law.\n\
 
   return return_code;
 }
+
+#ifdef KMK_BUILTIN_SED
+/* The kmk_builtin_sed entry point.  panic, bad_prog and friends
+   longjmp back here instead of exiting kmk. */
+int
+kmk_builtin_sed(argc, argv, envp)
+  int argc;
+  char **argv;
+  char **envp;
+{
+  jmp_buf exit_jmpbuf;
+  int rc;
+
+  (void)envp;
+  ck_exit_jmpbuf = &exit_jmpbuf;
+  if (!setjmp(exit_jmpbuf))
+    rc = sed_main(argc, argv);
+  else
+    {
+      rc = ck_exit_status;
+      ck_cleanup();
+      reset_executor();
+      if (script_key)
+	free_buffer(script_key);
+      script_key = NULL;
+    }
+  ck_exit_jmpbuf = NULL;
+  reset_compiler();
+  forget_last_regex();
+
+  if (the_program && !cached_program)
+    release_program(the_program);
+  the_program = NULL;
+  cached_program = NULL;
+  script_piece_count = 0;
+  if (in_place_extension)
+    FREE(in_place_extension);
+  in_place_extension = NULL;
+#ifndef CONFIG_WITHOUT_O_OPT
+  sed_stdout = stdout;		/* closed by ck_fclose or ck_cleanup */
+#endif
+
+  if (saved_locale)
+    {
+      setlocale (LC_ALL, saved_locale);
+      FREE(saved_locale);
+      saved_locale = NULL;
+      initialize_mbcs ();
+    }
+  return rc;
+}
+#endif /* KMK_BUILTIN_SED */
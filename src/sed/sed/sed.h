@@ -55,6 +55,14 @@ struct text_buf {
 struct regex {
   regex_t pattern;
   int flags;
+#ifndef REG_PERL
+  /* If the regexp is just a string, optionally anchored, this is the
+     string and match_regex looks for it without using the matcher. */
+  char *literal;
+  size_t literal_len;
+  bool literal_bol;	/* starts with ^ */
+  bool literal_eol;	/* ends with $ */
+#endif
   size_t sz;
   char re[1];
 };
@@ -127,6 +135,9 @@ struct subst {
   unsigned print : 2;	/* 'p' option given (before/after eval) */
   unsigned eval : 1;	/* 'e' option given */
   unsigned max_id : 4;  /* maximum backreference on the RHS */
+#ifdef KMK_BUILTIN_SED
+  char *replacement_text; /* the memory the replacement prefixes point into */
+#endif
 };
 
 #ifdef REG_PERL
@@ -193,18 +204,31 @@ struct vector *compile_file P_((struct vector *, const char *cmdfile));
 void check_final_program P_((struct vector *));
 void rewind_read_files P_((void));
 void finish_program P_((struct vector *));
+#ifdef KMK_BUILTIN_SED
+bool reusable_program P_((struct vector *));
+void release_program P_((struct vector *));
+void reset_compiler P_((void));
+void reset_executor P_((void));
+#endif
 
 struct regex *compile_regex P_((struct buffer *b, int flags, int needed_sub));
 int match_regex P_((struct regex *regex,
 		    char *buf, size_t buflen, size_t buf_start_offset,
 		    struct re_registers *regarray, int regsize));
-#ifdef DEBUG_LEAKS
+#if defined(DEBUG_LEAKS) || defined(KMK_BUILTIN_SED)
 void release_regex P_((struct regex *));
 #endif
+#ifdef KMK_BUILTIN_SED
+void forget_last_regex P_((void));
+#endif
 
 int process_files P_((struct vector *, char **argv));
 
+#ifdef KMK_BUILTIN_SED
+int kmk_builtin_sed P_((int, char **, char **));
+#else
 int main P_((int, char **));
+#endif
 
 extern void fmt P_ ((const char *line, const char *line_end, int max_length, FILE *output_file));
 
@@ -239,6 +263,7 @@ extern bool use_extended_syntax_p;
 
 /* Declarations for multibyte character sets.  */
 extern int mb_cur_max;
+extern bool is_utf8;
 
 #ifdef HAVE_MBRTOWC
 #ifdef HAVE_BTOWC
@@ -0,0 +1,63 @@
+#!/bin/sh -
+#
+# Time a few typical build system sed scripts over a large generated
+# input, optionally comparing two sed binaries.
+#
+#   sh bench.sh SED [OTHER-SED [LINES]]
+#
+# The outputs of the two binaries are compared as well, so this doubles
+# as a check of the literal string fast path in regexp.c.
+#
+
+SED=${1:?usage: bench.sh SED [OTHER-SED [LINES]]}
+OTHER=$2
+LINES=${3:-200000}
+TMP=${TMPDIR:-/tmp}/sed-bench.$$
+LC_ALL=C
+export LC_ALL
+
+trap 'rm -f $TMP.*' 0 1 2 15
+
+# Something looking like preprocessed C with some make output mixed in.
+i=0
+: > $TMP.1
+while test $i -lt 100; do
+  echo "# $i \"/usr/include/stdio.h\" 3 4" >> $TMP.1
+  echo "extern int fprintf (FILE *__restrict __stream, const char *__restrict __format, ...);" >> $TMP.1
+  echo "static const char g_szVersion$i[] = \"@VERSION@\";" >> $TMP.1
+  echo "obj/foo$i.o: src/foo$i.c include/foo.h \\" >> $TMP.1
+  echo "  typedef unsigned long size_t;	/* $i */" >> $TMP.1
+  i=`expr $i + 1`
+done
+n=500
+: > $TMP.in
+while test $n -le $LINES; do
+  cat $TMP.1 >> $TMP.in
+  n=`expr $n + 500`
+done
+
+run ()
+{
+  name=$1; shift
+  k=1
+  for s in "$SED" $OTHER; do
+    start=`date +%s%N`
+    "$s" "$@" $TMP.in > $TMP.out$k
+    end=`date +%s%N`
+    printf "%-12s %-40s %6d ms\n" "$name" "$s" `expr \( $end - $start \) / 1000000`
+    k=2
+  done
+  if test -n "$OTHER" && ! cmp -s $TMP.out1 $TMP.out2; then
+    echo "$name: outputs differ!"
+    exit 1
+  fi
+}
+
+run literal    -e 's/@VERSION@/1.2.3/'
+run literal-g  -e 's/__restrict/restrict/g'
+run anchored   -e '/^# /d'
+run eol        -e 's/ \\$//'
+run address    -n -e '/typedef/p'
+run class      -e 's/[0-9][0-9]*/N/g'
+run backref    -e 's/\(foo\)\([0-9]*\)/\2\1/'
+exit 0